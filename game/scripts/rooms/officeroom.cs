@@ -733,6 +733,7 @@ function exitToSecretRoom::onWalkTo(%this, %verb, %objA, %objB)
         egoSay("It's closed.");
         return;
     }
+    prefetchRoom(SecretRoom);
     walkActorTo($VAR_EGO, 290,110); waitForActor($VAR_EGO);
     screenEffect(0x0083);
     startRoom(SecretRoom);
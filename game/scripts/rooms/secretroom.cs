@@ -379,6 +379,7 @@ function node::onUsedWith(%this, %verb, %objA, %objB)
 
 function exitToOfficeRoom::onWalkTo(%this, %verb, %objA, %objB)
 {
+    prefetchRoom(OfficeRoom);
     $VAR_EGO.walkTo(50,100); 
     waitForActor($VAR_EGO);
     screenEffect(0x0082);
@@ -32,6 +32,7 @@ new Room(Skyline)
 function Skyline::onEntry(%this)
 {
     echo("Skyline onEntry");
+    prefetchRoom(OfficeRoom);
 
     try 
     {
@@ -20,6 +20,9 @@ ActorWalkState::ActorWalkState() : mWalkTarget(0,0), mAction(ACTION_IDLE), mWalk
   mWalkSpeed = Point2I(2,1);
   mPreferredAxis = 0;
    mNextBox = -1;
+   mNextWaypoint = 0;
+   mNeedPath = false;
+   mBlocked = false;
    
    mDebugSegment = Point2I(0,0);
    mDebugPoint = Point2I(0,0);
@@ -115,7 +118,41 @@ void ActorWalkState::adjustWalkTarget(Actor& actor)
   {
      Room* theRoom = dynamic_cast<Room*>(actor.getGroup());
      
-     if (theRoom &&
+     if (mNeedPath)
+     {
+        mNeedPath = false;
+        mNextWaypoint = 0;
+        mWaypoints.clear();
+        mPathBoxes.clear();
+        
+        if (theRoom &&
+            actor.mLastBox > 0 &&
+            actor.mLastBox != mRealWalkTargetBox &&
+            mRealWalkTargetBox > 0)
+        {
+           theRoom->findPath(actor.mLastBox, mRealWalkTargetBox,
+                             actor.mAnchor, mRealWalkTarget,
+                             mWaypoints, mPathBoxes);
+        }
+     }
+     
+     // Follow the planned path; if planning failed fall back to stepping
+     // through the BOXM hops
+     if (mNextWaypoint < mWaypoints.size())
+     {
+        while (mNextWaypoint + 1 < mWaypoints.size() &&
+               mWaypoints[mNextWaypoint] == actor.mAnchor)
+        {
+           mNextWaypoint++;
+        }
+        
+        mWalkTarget = mWaypoints[mNextWaypoint++];
+        mDebugPoint = mWalkTarget;
+        mDebugSegment = mWalkTarget;
+        mNextBox = -1;
+        mAction = mWalkTarget == mRealWalkTarget ? ACTION_MOVING : ACTION_MOVING_TO_EXIT_PORTAL;
+     }
+     else if (theRoom &&
          actor.mLastBox > 0 &&
          actor.mLastBox != mRealWalkTargetBox &&
          mRealWalkTargetBox > 0)
@@ -130,20 +167,18 @@ void ActorWalkState::adjustWalkTarget(Actor& actor)
            mWalkTarget = mRealWalkTarget;
            mAction = ACTION_MOVING;
         }
-        else if (mNextBox >= 0)
+        else if (mNextBox >= 0 && mNextBox < (S32)theRoom->mBoxes.boxes.size() &&
+                 BoxInfo::IsWalkableBox(theRoom->mBoxes.boxes[mNextBox]))
         {
            // Find the connecting edge in the TARGET box
-           BoxInfo::PortalEdgePair pe = theRoom->mBoxes.FindBestPortalEdgePair(actualBox, mNextBox);
+           const BoxInfo::Portal& pe = theRoom->mBoxes.getPortal(actualBox, mNextBox);
 
-           Point2I P0;
-           Point2I P1;
+           Point2I P0 = pe.overlapA;
+           Point2I P1 = pe.overlapB;
            Point2I portal;
            bool directWalk = false;
            
-           if (theRoom->mBoxes.ComputeOverlapSegment(
-                    pe.srcEdge.a, pe.srcEdge.b,
-                    pe.dstEdge.a, pe.dstEdge.b,
-                    P0, P1))
+           if (pe.hasSegment)
             {
                // If next box is actual target, move to that otherwise
                // try and aim for the center of the next box
@@ -196,7 +231,7 @@ void ActorWalkState::adjustWalkTarget(Actor& actor)
         }
         else
         {
-           // Something went wrong here, stop
+           // No usable hop (or it's disabled or locked), stop
            mWalkTarget = mRealWalkTarget;
            mAction = ACTION_IDLE;
         }
@@ -226,6 +261,7 @@ void Actor::initPersistFields()
    addField("displayText", TypeString, Offset(mDisplayText, Actor));
    addField("ignoreBoxes", TypeBool, Offset(mIgnoreBoxes, Actor));
    addField("elevation", TypeS32, Offset(mElevation, Actor));
+   addField("avoidRadius", TypeS32, Offset(mAvoidRadius, Actor));
 
    initDisplayFields();
 }
@@ -238,9 +274,12 @@ Actor::Actor()
   mTickSpeed = 4;
    mLayer = 0;
    mLastBox = -1;
+   mPrevAnchor = Point2I(0,0);
+   mListIndex = -1;
    mTalking = false;
    mIgnoreBoxes = false;
    mElevation = 0;
+   mAvoidRadius = 6;
    
    mDisplayOffset = Point2I(0,0);
 
@@ -263,7 +302,6 @@ bool Actor::onAdd()
 {
   if (Parent::onAdd())
   {
-     registerTickable();
      return true;
   }
   return false;
@@ -271,7 +309,7 @@ bool Actor::onAdd()
 
 void Actor::onRemove()
 {
-  unregisterTickable();
+  Parent::onRemove();
 }
 
 void Actor::setPosition(Point2I pos)
@@ -308,6 +346,9 @@ void Actor::setPosition(Point2I pos)
       mWalkState.mRealWalkTargetBox = -1;
    }
    
+   // Placed, not walked; don't blend from the old spot
+   mPrevAnchor = mAnchor;
+   
    // NOTE: this re-calculates frame bounds in this case
    updateLayout(RectI(0,0,0,0));
 }
@@ -346,6 +387,8 @@ void Actor::walkTo(Point2I pos)
    mWalkState.mWalkTarget = mAnchor;
    mWalkState.mRealWalkTarget = pos;
    mWalkState.mRealWalkTargetBox = -1;
+   mWalkState.mNeedPath = true;
+   mWalkState.mBlocked = false;
    
    if (mWalkState.mAction == ActorWalkState::ACTION_IDLE)
    {
@@ -375,57 +418,388 @@ void Actor::walkTo(Point2I pos)
    }
 }
 
-void Actor::onFixedTick(F32 dt)
+// RoomActorList
+
+void RoomActorList::add(Actor* actor)
 {
-  // Don't update if not in current room
-  if (getGroup() != gGlobals.currentRoom)
-  {
+   if (actor->mListIndex >= 0)
+   {
       return;
-  }
+   }
+   
+   actor->mListIndex = (S32)mActors.size();
+   mActors.push_back(actor);
+   mLookupPos.push_back(Point2I(0,0));
+   mLookupBox.push_back(-1);
+   mLookupEpoch.push_back(~0U);
+}
 
-  if (mTickCounter == 0)
-  {
-     if (mCostume)
-     {
-        ActorWalkState::CurrentAction lastAction = mWalkState.mAction;
-        mWalkState.updateTick(*this);
-        
-        // Update box
-        auto selectableFunc = +[](const BoxInfo::Box&){ return true; };
-        Room* room = dynamic_cast<Room*>(getGroup());
-        BoxInfo::AdjustBoxResult result;
-        
-        if (mIgnoreBoxes)
-        {
-           mLastBox = -1;
-        }
-        if (room->mBoxes.FindContainingBox(mAnchor, selectableFunc, true, 0, result) &&
-            result.box >= 0)
-        {
-           mLayer = room->mBoxes.boxes[result.box].mask;
-           mLastBox = result.box;
-        }
-        
-        mLiveCostume.advanceTick(mCostume->mState);
-        updateLayout(RectI(0,0,0,0));
-     }
-  }
-  
-  mTickCounter++;
-  if (mTickCounter >= mTickSpeed)
-  {
-     mTickCounter = 0;
-  }
+void RoomActorList::remove(Actor* actor)
+{
+   const S32 idx = actor->mListIndex;
+   if (idx < 0 || idx >= (S32)mActors.size() || mActors[idx] != actor)
+   {
+      return;
+   }
+   
+   // Swap the last actor into the hole
+   const S32 last = (S32)mActors.size() - 1;
+   mActors[idx] = mActors[last];
+   mLookupPos[idx] = mLookupPos[last];
+   mLookupBox[idx] = mLookupBox[last];
+   mLookupEpoch[idx] = mLookupEpoch[last];
+   mActors[idx]->mListIndex = idx;
+   
+   mActors.pop_back();
+   mLookupPos.pop_back();
+   mLookupBox.pop_back();
+   mLookupEpoch.pop_back();
+   actor->mListIndex = -1;
+}
+
+void RoomActorList::tick(Room* room)
+{
+   const U32 count = (U32)mActors.size();
+   mDue.clear();
+   
+   // Counters first; only actors on their step do any real work
+   for (U32 i=0; i<count; i++)
+   {
+      Actor* actor = mActors[i];
+      if (actor->mTickCounter == 0 && actor->mCostume)
+      {
+         mDue.push_back(i);
+      }
+      
+      actor->mTickCounter++;
+      if (actor->mTickCounter >= actor->mTickSpeed)
+      {
+         actor->mTickCounter = 0;
+      }
+   }
+   
+   for (U32 i : mDue)
+   {
+      mActors[i]->mPrevAnchor = mActors[i]->mAnchor;
+      mActors[i]->mWalkState.updateTick(*mActors[i]);
+   }
+   
+   if (room->mActorAvoidance)
+   {
+      applyAvoidance(room);
+   }
+   
+   // Update boxes; actors which haven't moved reuse their last lookup, the
+   // rest start from the box they were in
+   auto selectableFunc = +[](const BoxInfo::Box&){ return true; };
+   for (U32 i : mDue)
+   {
+      Actor* actor = mActors[i];
+      
+      if (mLookupEpoch[i] != room->mBoxEpoch ||
+          mLookupPos[i] != actor->mAnchor)
+      {
+         BoxInfo::AdjustBoxResult result;
+         mLookupBox[i] = room->mBoxes.TrackContainingBox(actor->mAnchor, mLookupBox[i], selectableFunc, true, result) ? result.box : -1;
+         mLookupPos[i] = actor->mAnchor;
+         mLookupEpoch[i] = room->mBoxEpoch;
+      }
+      
+      if (actor->mIgnoreBoxes)
+      {
+         actor->mLastBox = -1;
+      }
+      if (mLookupBox[i] >= 0)
+      {
+         actor->mLayer = room->mBoxes.boxes[mLookupBox[i]].mask;
+         actor->mLastBox = mLookupBox[i];
+      }
+      
+      actor->mLiveCostume.scale = actor->mIgnoreBoxes ? 1.0f : room->mBoxes.getScaleAt(mLookupBox[i], actor->mAnchor);
+   }
+   
+   for (U32 i : mDue)
+   {
+      Actor* actor = mActors[i];
+      actor->mLiveCostume.advanceTick(actor->mCostume->mState);
+      actor->updateLayout(RectI(0,0,0,0));
+   }
+}
+
+static inline U32 AvoidHash(S32 cx, S32 cy, U32 mask)
+{
+   return (((U32)cx * 73856093U) ^ ((U32)cy * 19349663U)) & mask;
+}
+
+static inline S32 AvoidRadius(const Actor* actor)
+{
+   return std::min<S32>(actor->mAvoidRadius, RoomActorList::AvoidMaxRadius);
+}
+
+void RoomActorList::buildAvoidHash()
+{
+   const U32 count = (U32)mActors.size();
+   U32 nBuckets = 16;
+   while (nBuckets < count * 2)
+   {
+      nBuckets <<= 1;
+   }
+   mAvoidMask = nBuckets - 1;
+   
+   mAvoidBucketStart.assign(nBuckets + 1, 0);
+   mAvoidBucket.resize(count);
+   
+   for (U32 i=0; i<count; i++)
+   {
+      const Actor* actor = mActors[i];
+      if (AvoidRadius(actor) <= 0 || !actor->mCostume)
+      {
+         mAvoidBucket[i] = ~0U;
+         continue;
+      }
+      
+      mAvoidBucket[i] = AvoidHash(actor->mAnchor.x >> AvoidCellShift, actor->mAnchor.y >> AvoidCellShift, mAvoidMask);
+      mAvoidBucketStart[mAvoidBucket[i] + 1]++;
+   }
+   
+   for (U32 b=0; b<nBuckets; b++)
+   {
+      mAvoidBucketStart[b+1] += mAvoidBucketStart[b];
+   }
+   
+   // Fill using each bucket's start as its cursor, which leaves every start
+   // at the next bucket's; shift them back afterwards
+   mAvoidEntries.resize(mAvoidBucketStart[nBuckets]);
+   for (U32 i=0; i<count; i++)
+   {
+      if (mAvoidBucket[i] != ~0U)
+      {
+         mAvoidEntries[mAvoidBucketStart[mAvoidBucket[i]]++] = i;
+      }
+   }
+   
+   for (U32 b=nBuckets; b>0; b--)
+   {
+      mAvoidBucketStart[b] = mAvoidBucketStart[b-1];
+   }
+   mAvoidBucketStart[0] = 0;
+}
+
+// Nudges walking actors away from anyone they overlap, sidestepping those
+// ahead of them. Only positions inside a walkable box are accepted, so this
+// never pushes an actor off the walk map. Actors which are stood on their
+// destination make a walker stop at the nearest free spot beside them.
+void RoomActorList::applyAvoidance(Room* room)
+{
+   buildAvoidHash();
+   
+   auto walkableFunc = +[](const BoxInfo::Box& b){ return BoxInfo::IsWalkableBox(b); };
+   
+   for (U32 i : mDue)
+   {
+      Actor* actor = mActors[i];
+      ActorWalkState& walk = actor->mWalkState;
+      if (mAvoidBucket[i] == ~0U ||
+          walk.mAction < ActorWalkState::ACTION_MOVING)
+      {
+         continue;
+      }
+      
+      const Point2I pos = actor->mAnchor;
+      const Point2I heading = walk.mWalkTarget - pos;
+      const S32 radius = AvoidRadius(actor);
+      const S32 cx = pos.x >> AvoidCellShift;
+      const S32 cy = pos.y >> AvoidCellShift;
+      
+      F32 pushX = 0.0f;
+      F32 pushY = 0.0f;
+      bool blockedTarget = false;
+      const Actor* blocker = NULL;
+      S32 blockerDist = 0;
+      
+      // Neighbouring cells can share a bucket, so skip ones already seen
+      U32 visited[9];
+      U32 numVisited = 0;
+      
+      for (S32 dy=-1; dy<=1 && !blockedTarget; dy++)
+      {
+         for (S32 dx=-1; dx<=1 && !blockedTarget; dx++)
+         {
+            const U32 bucket = AvoidHash(cx + dx, cy + dy, mAvoidMask);
+            if (std::find(visited, visited + numVisited, bucket) != visited + numVisited)
+            {
+               continue;
+            }
+            visited[numVisited++] = bucket;
+            
+            for (U32 k=mAvoidBucketStart[bucket]; k<mAvoidBucketStart[bucket+1]; k++)
+            {
+               const U32 j = mAvoidEntries[k];
+               const Actor* other = mActors[j];
+               if (j == i)
+               {
+                  continue;
+               }
+               
+               const S32 minDist = radius + AvoidRadius(other);
+               const Point2I away = pos - other->mAnchor;
+               const S32 d2 = (away.x * away.x) + (away.y * away.y);
+               if (d2 >= minDist * minDist)
+               {
+                  continue;
+               }
+               
+               const Point2I toTarget = walk.mRealWalkTarget - other->mAnchor;
+               if (other->mWalkState.mAction <= ActorWalkState::ACTION_IDLE &&
+                   (toTarget.x * toTarget.x) + (toTarget.y * toTarget.y) < minDist * minDist)
+               {
+                  blockedTarget = true;
+                  blocker = other;
+                  blockerDist = minDist;
+                  break;
+               }
+               
+               F32 ux = i < j ? 1.0f : -1.0f; // exactly on top, split sideways
+               F32 uy = 0.0f;
+               F32 dist = std::sqrt(F32(d2));
+               if (d2 > 0)
+               {
+                  ux = away.x / dist;
+                  uy = away.y / dist;
+               }
+               
+               const F32 overlap = F32(minDist) - dist;
+               pushX += ux * overlap;
+               pushY += uy * overlap;
+               
+               // Someone ahead; step around them rather than just backing off
+               if ((heading.x * away.x) + (heading.y * away.y) < 0)
+               {
+                  const F32 len = std::sqrt(F32((heading.x * heading.x) + (heading.y * heading.y)));
+                  F32 sideX = -heading.y / len;
+                  F32 sideY = heading.x / len;
+                  if ((sideX * away.x) + (sideY * away.y) < 0.0f)
+                  {
+                     sideX = -sideX;
+                     sideY = -sideY;
+                  }
+                  pushX += sideX * overlap;
+                  pushY += sideY * overlap;
+               }
+            }
+         }
+      }
+      
+      if (blockedTarget)
+      {
+         // Retarget to just outside the blocker on our side of it, so the
+         // walk still finishes normally
+         Point2I away = pos - blocker->mAnchor;
+         if (away == Point2I(0,0))
+         {
+            away = -heading;
+         }
+         
+         Point2I spot = pos;
+         S32 spotBox = mLookupBox[i];
+         const F32 len = std::sqrt(F32((away.x * away.x) + (away.y * away.y)));
+         if (len > 0.0f)
+         {
+            const F32 scale = F32(blockerDist + 1) / len;
+            spot = blocker->mAnchor + Point2I((S32)std::lround(away.x * scale), (S32)std::lround(away.y * scale));
+            
+            BoxInfo::AdjustBoxResult result;
+            if (actor->mIgnoreBoxes)
+            {
+               spotBox = -1;
+            }
+            else if (room->mBoxes.FindNearestBoxAndSnapPoint(spot, walkableFunc, true, 0, result))
+            {
+               spot = result.pos;
+               spotBox = result.box;
+            }
+            else
+            {
+               spot = pos;
+            }
+         }
+         
+         walk.mBlocked = true;
+         walk.mWaypoints.clear();
+         walk.mPathBoxes.clear();
+         walk.mNextWaypoint = 0;
+         walk.mNeedPath = false;
+         walk.mRealWalkTarget = spot;
+         walk.mRealWalkTargetBox = spotBox;
+         walk.mWalkTarget = spot;
+         
+         if (spot == pos)
+         {
+            actor->setStanding();
+         }
+         else
+         {
+            walk.mAction = ActorWalkState::ACTION_MOVING;
+         }
+         continue;
+      }
+      
+      const Point2I step(walk.clampStep((S32)std::lround(pushX), walk.mWalkSpeed.x),
+                         walk.clampStep((S32)std::lround(pushY), walk.mWalkSpeed.y));
+      if (step == Point2I(0,0))
+      {
+         continue;
+      }
+      
+      // Try the full push, then each axis on its own
+      const Point2I candidates[3] = { pos + step, Point2I(pos.x + step.x, pos.y), Point2I(pos.x, pos.y + step.y) };
+      for (U32 c=0; c<3; c++)
+      {
+         BoxInfo::AdjustBoxResult result;
+         if (candidates[c] != pos &&
+             (actor->mIgnoreBoxes ||
+              room->mBoxes.TrackContainingBox(candidates[c], mLookupBox[i], walkableFunc, true, result)))
+         {
+            actor->mAnchor = candidates[c];
+            break;
+         }
+      }
+   }
+}
+
+// Actors only move on their step tick, so the drawn position blends from
+// before the step to after it over the mTickSpeed ticks until the next one.
+Point2F Actor::getRenderAnchor() const
+{
+   if (mPrevAnchor == mAnchor)
+   {
+      return Point2F(mAnchor.x, mAnchor.y);
+   }
+   
+   const S32 speed = std::max<S32>(mTickSpeed, 1);
+   const S32 elapsed = mTickCounter == 0 ? speed : mTickCounter;
+   const F32 t = getMin(((elapsed - 1) + gGlobals.renderAlpha) / (F32)speed, 1.0f);
+   
+   return Point2F(mPrevAnchor.x + ((mAnchor.x - mPrevAnchor.x) * t),
+                  mPrevAnchor.y + ((mAnchor.y - mPrevAnchor.y) * t));
 }
 
 void Actor::onRender(Point2I offset, RectI drawRect, Camera2D& globalCamera)
 {
   if (mCostume)
   {
-     mLiveCostume.position = Point2F(mAnchor.x, mAnchor.y) + Point2F(mDisplayOffset.x, mDisplayOffset.y) - Point2F(0.0f, mElevation);
+     mLiveCostume.position = getRenderAnchor() + Point2F(mDisplayOffset.x, mDisplayOffset.y) - Point2F(0.0f, mElevation);
      //mLiveCostume.w
+     mLiveCostume.maskLayer = mLayer;
      mLiveCostume.render(mCostume->mState);
-     
+  }
+}
+
+// Drawn after the room flushes its sprite batch so it stays on top
+void Actor::renderDebug()
+{
+  if (mCostume)
+  {
      // Draw debug stuff
      if (true)
      {
@@ -435,6 +809,14 @@ void Actor::onRender(Point2I offset, RectI drawRect, Camera2D& globalCamera)
         ::DrawCircleLines(mWalkState.mDebugPoint.x, mWalkState.mDebugPoint.y, 10, YELLOW);
         ::DrawCircleLines(mWalkState.mDebugSegment.x, mWalkState.mDebugSegment.y, 7, PURPLE);
         
+        Point2I prevWaypoint = mAnchor;
+        for (U32 i=mWalkState.mNextWaypoint > 0 ? mWalkState.mNextWaypoint-1 : 0; i<mWalkState.mWaypoints.size(); i++)
+        {
+           const Point2I& waypoint = mWalkState.mWaypoints[i];
+           ::DrawLine(prevWaypoint.x, prevWaypoint.y, waypoint.x, waypoint.y, ORANGE);
+           prevWaypoint = waypoint;
+        }
+        
         Room* ourRoom = dynamic_cast<Room*>(getGroup());
         if (ourRoom)
         {
@@ -687,6 +1069,12 @@ ConsoleMethodValue(Actor, isMoving, 2, 2, "")
    return KorkApi::ConsoleValue::makeUnsigned(object->mWalkState.mAction > ActorWalkState::ACTION_IDLE);
 }
 
+// True if the last walk stopped short because someone was stood on the target
+ConsoleMethodValue(Actor, isWalkBlocked, 2, 2, "")
+{
+   return KorkApi::ConsoleValue::makeUnsigned(object->mWalkState.mBlocked);
+}
+
 ConsoleMethodValue(Actor, getLayer, 2, 2, "")
 {
    return KorkApi::ConsoleValue::makeUnsigned(object->mLayer);
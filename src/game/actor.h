@@ -47,15 +47,12 @@ struct ActorWalkState
    Point2I mDebugPoint;
    
    S32 mNextBox; // Box we are currently trying to move into
-
-
-   enum
-   {
-      MaxPath = 8
-   };
    
-   std::array<U8, MaxPath> mPathBoxes;
-   U32 mPathBoxesLength;
+   std::vector<Point2I> mWaypoints; // Planned path to mRealWalkTarget
+   std::vector<U16> mPathBoxes;     // Boxes the planned path goes through
+   U32 mNextWaypoint;
+   bool mNeedPath;                  // Walk target changed, plan on next adjust
+   bool mBlocked;                   // Target was occupied, walk stops beside it
    
    ActorWalkState();
    inline void reset();
@@ -78,6 +75,11 @@ inline void ActorWalkState::reset()
   mDirection = CostumeRenderer::SOUTH;
   mAction = ACTION_IDLE;
   mTieAxis = 0;
+  mWaypoints.clear();
+  mPathBoxes.clear();
+  mNextWaypoint = 0;
+  mNeedPath = false;
+  mBlocked = false;
 }
 
 inline int ActorWalkState::sign(int x) {
@@ -136,7 +138,7 @@ inline CostumeRenderer::DirectionValue ActorWalkState::dirFromDominantAxis(S32 v
   return lookupTable[(2 * axis) + (value > 0 ? 1 : 0)];
 }
 
-class Actor : public DisplayBase, public ITickable
+class Actor : public DisplayBase
 {
    typedef DisplayBase Parent;
 public:
@@ -147,7 +149,10 @@ public:
    U16 mTickSpeed;
    U8 mLayer;
    S32 mLastBox;
+   Point2I mPrevAnchor; // mAnchor before the last walk step, for drawing
+   S32 mListIndex; // slot in the owning room's RoomActorList
    S32 mElevation;
+   S32 mAvoidRadius; // used when the room has actorAvoidance, 0 to opt out
    bool mTalking;
    bool mIgnoreBoxes;
    
@@ -179,9 +184,10 @@ public:
    
    void walkTo(Point2I pos);
    
-   virtual void onFixedTick(F32 dt);
+   Point2F getRenderAnchor() const;
    
    virtual void onRender(Point2I offset, RectI drawRect, Camera2D& globalCamera);
+   void renderDebug();
    
    void startAnim(StringTableEntry animName);
    
@@ -202,5 +208,41 @@ public:
    DECLARE_CONOBJECT(Actor);
 };
 
+class Room;
+
+// Actors don't tick themselves; the room steps all of its actors together,
+// one stage at a time. The actor objects still own everything scripts can
+// see, the arrays here are per-tick scratch and cached box lookups.
+class RoomActorList
+{
+public:
+   enum
+   {
+      AvoidCellShift = 5, // 32 pixel spatial hash cells
+      AvoidMaxRadius = 14 // keeps any overlapping pair within adjacent cells
+   };
+   
+   std::vector<Actor*> mActors;
+   std::vector<Point2I> mLookupPos; // anchor at the last box lookup
+   std::vector<S32> mLookupBox;     // box found there, -1 if none
+   std::vector<U32> mLookupEpoch;   // room box epoch of the lookup
+   std::vector<U32> mDue;           // actors taking a step this tick
+   
+   // Spatial hash of actor anchors for avoidance, rebuilt each tick
+   std::vector<U32> mAvoidBucketStart; // bucket count + 1 offsets into mAvoidEntries
+   std::vector<U32> mAvoidEntries;
+   std::vector<U32> mAvoidBucket;      // per actor, ~0 if not avoiding
+   U32 mAvoidMask;
+   
+   RoomActorList() : mAvoidMask(0) {;}
+   
+   void add(Actor* actor);
+   void remove(Actor* actor);
+   void tick(Room* room);
+   
+   void buildAvoidHash();
+   void applyAvoidance(Room* room);
+};
+
 
 END_SW_NS
@@ -0,0 +1,290 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOX_KERNELS_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__aarch64__) || defined(_M_ARM64))
+#define BOX_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+// Fixed four-edge versions of the BoxInfo polygon tests. Walk boxes are
+// always quads, so all four edges are done at once instead of looping with
+// a wraparound. Results match the generic BoxInfo functions.
+namespace BoxKernels
+{
+
+static_assert(sizeof(Point2I) == sizeof(S32) * 2, "Point2I must be two packed S32s");
+
+#if defined(BOX_KERNELS_SSE2)
+
+// Low 32 bits of a 32x32 multiply; SSE2 has no pmulld
+static inline __m128i Mul32(__m128i a, __m128i b)
+{
+   __m128i even = _mm_mul_epu32(a, b);
+   __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+   return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+                             _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+// Splits quad points into x and y lanes for edge starts (a) and ends (b)
+static inline void LoadQuad(const Point2I* quad, __m128i& ax, __m128i& ay, __m128i& bx, __m128i& by)
+{
+   __m128i p01 = _mm_loadu_si128((const __m128i*)quad);       // x0 y0 x1 y1
+   __m128i p23 = _mm_loadu_si128((const __m128i*)(quad + 2)); // x2 y2 x3 y3
+   __m128i x01y01 = _mm_shuffle_epi32(p01, _MM_SHUFFLE(3,1,2,0));
+   __m128i x23y23 = _mm_shuffle_epi32(p23, _MM_SHUFFLE(3,1,2,0));
+   ax = _mm_unpacklo_epi64(x01y01, x23y23);
+   ay = _mm_unpackhi_epi64(x01y01, x23y23);
+   bx = _mm_shuffle_epi32(ax, _MM_SHUFFLE(0,3,2,1));
+   by = _mm_shuffle_epi32(ay, _MM_SHUFFLE(0,3,2,1));
+}
+
+static inline __m128i Min32(__m128i a, __m128i b)
+{
+   __m128i gt = _mm_cmpgt_epi32(a, b);
+   return _mm_or_si128(_mm_and_si128(gt, b), _mm_andnot_si128(gt, a));
+}
+
+static inline __m128i Max32(__m128i a, __m128i b)
+{
+   __m128i gt = _mm_cmpgt_epi32(a, b);
+   return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+static inline bool QuadContainsPoint(const Point2I* quad, Point2I p)
+{
+   __m128i ax, ay, bx, by;
+   LoadQuad(quad, ax, ay, bx, by);
+
+   const __m128i px = _mm_set1_epi32(p.x);
+   const __m128i py = _mm_set1_epi32(p.y);
+
+   // mCross(a, b, p) for each edge
+   __m128i cross = _mm_sub_epi32(Mul32(_mm_sub_epi32(bx, ax), _mm_sub_epi32(py, ay)),
+                                 Mul32(_mm_sub_epi32(by, ay), _mm_sub_epi32(px, ax)));
+
+   const __m128i zero = _mm_setzero_si128();
+   __m128i onLine = _mm_cmpeq_epi32(cross, zero);
+
+   // On an edge counts as inside
+   __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmpgt_epi32(Min32(ax, bx), px), _mm_cmpgt_epi32(px, Max32(ax, bx))),
+                                  _mm_or_si128(_mm_cmpgt_epi32(Min32(ay, by), py), _mm_cmpgt_epi32(py, Max32(ay, by))));
+   if (_mm_movemask_epi8(_mm_andnot_si128(outside, onLine)) != 0)
+   {
+      return true;
+   }
+
+   // Inside if the non-zero crosses all agree
+   const bool anyPos = _mm_movemask_epi8(_mm_cmpgt_epi32(cross, zero)) != 0;
+   const bool anyNeg = _mm_movemask_epi8(_mm_cmplt_epi32(cross, zero)) != 0;
+   return !(anyPos && anyNeg);
+}
+
+// std::lround, i.e. halves away from zero. Truncates then steps away from
+// zero if the dropped fraction is at least a half; adding 0.5 first would
+// round values just under a half (0.49999997f) up.
+static inline __m128i Round32(__m128 v)
+{
+   const __m128i whole = _mm_cvttps_epi32(v);
+   const __m128 frac = _mm_sub_ps(v, _mm_cvtepi32_ps(whole));
+   const __m128i up = _mm_castps_si128(_mm_cmpge_ps(frac, _mm_set1_ps(0.5f)));
+   const __m128i down = _mm_castps_si128(_mm_cmple_ps(frac, _mm_set1_ps(-0.5f)));
+   return _mm_add_epi32(_mm_sub_epi32(whole, up), down);
+}
+
+static inline Point2I QuadClosestEdgePoint(const Point2I* quad, Point2I p)
+{
+   __m128i ax, ay, bx, by;
+   LoadQuad(quad, ax, ay, bx, by);
+
+   const __m128 fax = _mm_cvtepi32_ps(ax);
+   const __m128 fay = _mm_cvtepi32_ps(ay);
+   const __m128 abx = _mm_sub_ps(_mm_cvtepi32_ps(bx), fax);
+   const __m128 aby = _mm_sub_ps(_mm_cvtepi32_ps(by), fay);
+   const __m128 apx = _mm_sub_ps(_mm_set1_ps(F32(p.x)), fax);
+   const __m128 apy = _mm_sub_ps(_mm_set1_ps(F32(p.y)), fay);
+
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 denom = _mm_add_ps(_mm_mul_ps(abx, abx), _mm_mul_ps(aby, aby));
+   __m128 t = _mm_div_ps(_mm_add_ps(_mm_mul_ps(apx, abx), _mm_mul_ps(apy, aby)), denom);
+   t = _mm_and_ps(t, _mm_cmpgt_ps(denom, zero)); // zero length edges use a
+   t = _mm_min_ps(_mm_max_ps(t, zero), _mm_set1_ps(1.0f));
+
+   __m128i qx = Round32(_mm_add_ps(fax, _mm_mul_ps(t, abx)));
+   __m128i qy = Round32(_mm_add_ps(fay, _mm_mul_ps(t, aby)));
+   __m128i dx = _mm_sub_epi32(_mm_set1_epi32(p.x), qx);
+   __m128i dy = _mm_sub_epi32(_mm_set1_epi32(p.y), qy);
+   __m128i d2 = _mm_add_epi32(Mul32(dx, dx), Mul32(dy, dy));
+
+   alignas(16) S32 lanesX[4];
+   alignas(16) S32 lanesY[4];
+   alignas(16) S32 lanesD2[4];
+   _mm_store_si128((__m128i*)lanesX, qx);
+   _mm_store_si128((__m128i*)lanesY, qy);
+   _mm_store_si128((__m128i*)lanesD2, d2);
+
+   // First closest edge wins, same as the generic loop
+   U32 best = 0;
+   for (U32 i = 1; i < 4; i++)
+   {
+      if (lanesD2[i] < lanesD2[best])
+      {
+         best = i;
+      }
+   }
+   return Point2I(lanesX[best], lanesY[best]);
+}
+
+#elif defined(BOX_KERNELS_NEON)
+
+static inline void LoadQuad(const Point2I* quad, int32x4_t& ax, int32x4_t& ay, int32x4_t& bx, int32x4_t& by)
+{
+   int32x4x2_t xy = vld2q_s32((const int32_t*)quad);
+   ax = xy.val[0];
+   ay = xy.val[1];
+   bx = vextq_s32(ax, ax, 1);
+   by = vextq_s32(ay, ay, 1);
+}
+
+static inline bool QuadContainsPoint(const Point2I* quad, Point2I p)
+{
+   int32x4_t ax, ay, bx, by;
+   LoadQuad(quad, ax, ay, bx, by);
+
+   const int32x4_t px = vdupq_n_s32(p.x);
+   const int32x4_t py = vdupq_n_s32(p.y);
+
+   int32x4_t cross = vsubq_s32(vmulq_s32(vsubq_s32(bx, ax), vsubq_s32(py, ay)),
+                               vmulq_s32(vsubq_s32(by, ay), vsubq_s32(px, ax)));
+
+   const int32x4_t zero = vdupq_n_s32(0);
+   uint32x4_t onLine = vceqq_s32(cross, zero);
+   uint32x4_t inside = vandq_u32(vandq_u32(vcleq_s32(vminq_s32(ax, bx), px), vcleq_s32(px, vmaxq_s32(ax, bx))),
+                                 vandq_u32(vcleq_s32(vminq_s32(ay, by), py), vcleq_s32(py, vmaxq_s32(ay, by))));
+   if (vmaxvq_u32(vandq_u32(onLine, inside)) != 0)
+   {
+      return true;
+   }
+
+   const bool anyPos = vmaxvq_u32(vcgtq_s32(cross, zero)) != 0;
+   const bool anyNeg = vmaxvq_u32(vcltq_s32(cross, zero)) != 0;
+   return !(anyPos && anyNeg);
+}
+
+static inline int32x4_t Round32(float32x4_t v)
+{
+   // vcvtaq rounds halves away from zero, like std::lround
+   return vcvtaq_s32_f32(v);
+}
+
+static inline Point2I QuadClosestEdgePoint(const Point2I* quad, Point2I p)
+{
+   int32x4_t ax, ay, bx, by;
+   LoadQuad(quad, ax, ay, bx, by);
+
+   const float32x4_t fax = vcvtq_f32_s32(ax);
+   const float32x4_t fay = vcvtq_f32_s32(ay);
+   const float32x4_t abx = vsubq_f32(vcvtq_f32_s32(bx), fax);
+   const float32x4_t aby = vsubq_f32(vcvtq_f32_s32(by), fay);
+   const float32x4_t apx = vsubq_f32(vdupq_n_f32(F32(p.x)), fax);
+   const float32x4_t apy = vsubq_f32(vdupq_n_f32(F32(p.y)), fay);
+
+   const float32x4_t zero = vdupq_n_f32(0.0f);
+   const float32x4_t denom = vaddq_f32(vmulq_f32(abx, abx), vmulq_f32(aby, aby));
+   float32x4_t t = vdivq_f32(vaddq_f32(vmulq_f32(apx, abx), vmulq_f32(apy, aby)), denom);
+   t = vbslq_f32(vcgtq_f32(denom, zero), t, zero);
+   t = vminq_f32(vmaxq_f32(t, zero), vdupq_n_f32(1.0f));
+
+   int32x4_t qx = Round32(vaddq_f32(fax, vmulq_f32(t, abx)));
+   int32x4_t qy = Round32(vaddq_f32(fay, vmulq_f32(t, aby)));
+   int32x4_t dx = vsubq_s32(vdupq_n_s32(p.x), qx);
+   int32x4_t dy = vsubq_s32(vdupq_n_s32(p.y), qy);
+   int32x4_t d2 = vaddq_s32(vmulq_s32(dx, dx), vmulq_s32(dy, dy));
+
+   S32 lanesX[4];
+   S32 lanesY[4];
+   S32 lanesD2[4];
+   vst1q_s32(lanesX, qx);
+   vst1q_s32(lanesY, qy);
+   vst1q_s32(lanesD2, d2);
+
+   U32 best = 0;
+   for (U32 i = 1; i < 4; i++)
+   {
+      if (lanesD2[i] < lanesD2[best])
+      {
+         best = i;
+      }
+   }
+   return Point2I(lanesX[best], lanesY[best]);
+}
+
+#else
+
+// Plain unrolled versions for anything else
+
+static inline bool QuadContainsPoint(const Point2I* quad, Point2I p)
+{
+   S32 cross[4];
+   bool anyPos = false;
+   bool anyNeg = false;
+
+   for (U32 i = 0; i < 4; i++)
+   {
+      const Point2I& a = quad[i];
+      const Point2I& b = quad[(i + 1) & 3];
+      cross[i] = mCross(a, b, p);
+
+      if (cross[i] == 0 &&
+          std::min(a.x, b.x) <= p.x && p.x <= std::max(a.x, b.x) &&
+          std::min(a.y, b.y) <= p.y && p.y <= std::max(a.y, b.y))
+      {
+         return true;
+      }
+   }
+
+   for (U32 i = 0; i < 4; i++)
+   {
+      anyPos |= cross[i] > 0;
+      anyNeg |= cross[i] < 0;
+   }
+   return !(anyPos && anyNeg);
+}
+
+static inline Point2I QuadClosestEdgePoint(const Point2I* quad, Point2I p)
+{
+   Point2I best = quad[0];
+   S32 bestD2 = std::numeric_limits<S32>::max();
+
+   for (U32 i = 0; i < 4; i++)
+   {
+      const F32 ax = F32(quad[i].x), ay = F32(quad[i].y);
+      const F32 abx = F32(quad[(i + 1) & 3].x) - ax, aby = F32(quad[(i + 1) & 3].y) - ay;
+      const F32 denom = abx * abx + aby * aby;
+      F32 t = denom > 0.0f ? ((F32(p.x) - ax) * abx + (F32(p.y) - ay) * aby) / denom : 0.0f;
+      t = std::min(std::max(t, 0.0f), 1.0f);
+
+      Point2I q(int(std::lround(ax + t * abx)), int(std::lround(ay + t * aby)));
+      S32 d2 = (p - q).lenSquared();
+      if (d2 < bestD2)
+      {
+         bestD2 = d2;
+         best = q;
+      }
+   }
+   return best;
+}
+
+#endif
+
+}
@@ -198,9 +198,16 @@ bool Costume::compileCostume()
                      
                      // set frame number
                      CostumeRenderer::Frame frame = {};
-                     theSet->ensureImageLoaded(ctrl.setParam);
-                     frame.displayImage = gTextureManager->loadTexture(theSet->makeImageFilename(ctrl.setParam),
-                                                                       &theSet->mLoadedImages[ctrl.setParam]);
+                     U32 loadFlags = TextureManager::LOAD_ATLAS;
+                     if ((theSet->mFlags & ImageSet::FLAG_TRANSPARENT) != 0)
+                     {
+                        loadFlags |= TextureManager::LOAD_COLOR_KEY;
+                     }
+                     
+                     // Decoded in the background; frame is empty until then
+                     frame.displayImage = gTextureManager->loadTextureAsync(theSet->makeImageFilename(ctrl.setParam),
+                                                                            theSet->expandImageFilename(ctrl.setParam),
+                                                                            loadFlags);
                      frame.displayOffset = theSet->mOffset;
                      frame.setFlags = (U8)theSet->mFlags;
                      cmd.param = mState.mFrames.size();
@@ -302,6 +309,7 @@ void CostumeRenderer::LiveState::reset()
    position = Point2F(0.0f, 0.0f);
    delta = Point2F(0.0f, 0.0f);
    scale = 1.0f;
+   maskLayer = 0;
 }
 
 void CostumeRenderer::LiveState::resetAnim(StaticState& state, U8 direction)
@@ -338,6 +346,18 @@ S32 CostumeRenderer::LiveState::lookupAnim(StaticState& state, StringTableEntry
    return -1;
 }
 
+bool CostumeRenderer::LiveState::isAnimating() const
+{
+   for (const LimbState& limbState : mLimbState)
+   {
+      if (limbState.nextCmd < limbState.track.numCommands)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
 bool CostumeRenderer::LiveState::isAnimPlaying(StaticState& state, U32 animId)
 {
    if (animId >= state.mAnims.size())
@@ -486,15 +506,15 @@ RectI CostumeRenderer::LiveState::getCurrentBounds(CostumeRenderer::StaticState&
          {
             if (doFlip)
             {
-               drawPos += (Point2F(-(frame.displayOffset.x + slot->mTexture.width), frame.displayOffset.y)) * scale;
+               drawPos += (Point2F(-(frame.displayOffset.x + slot->getWidth()), frame.displayOffset.y)) * scale;
             }
             else
             {
                drawPos += (Point2F(frame.displayOffset.x, frame.displayOffset.y)) * scale;
             }            
 
-            const F32 w = slot->mTexture.width  * scale;
-            const F32 h = slot->mTexture.height * scale;
+            const F32 w = slot->getWidth()  * scale;
+            const F32 h = slot->getHeight() * scale;
 
             const Point2F rectMin(drawPos.x,       drawPos.y);
             const Point2F rectMax(drawPos.x + w,   drawPos.y + h);
@@ -517,7 +537,13 @@ RectI CostumeRenderer::LiveState::getCurrentBounds(CostumeRenderer::StaticState&
 
 void CostumeRenderer::LiveState::render(CostumeRenderer::StaticState& state)
 {
+   if (gGlobals.headless)
+   {
+      return;
+   }
+   
    bool doFlip = false;
+   const Color tint = { 255, 255, 255, (U8)(255 - maskLayer) };
    
    if ((globalFlags & CostumeRenderer::FLIP) != 0)
    {
@@ -542,34 +568,24 @@ void CostumeRenderer::LiveState::render(CostumeRenderer::StaticState& state)
          {
             if (doFlip)
             {
-               drawPos += (Point2F(-(frame.displayOffset.x + slot->mTexture.width), frame.displayOffset.y)) * scale;
+               drawPos += (Point2F(-(frame.displayOffset.x + slot->getWidth()), frame.displayOffset.y)) * scale;
             }
             else
             {
                drawPos += (Point2F(frame.displayOffset.x, frame.displayOffset.y)) * scale;
             }
             
-            ::Rectangle source = {0, 0, (float)slot->mTexture.width, (float)slot->mTexture.height};
-            ::Rectangle dest = {drawPos.x, drawPos.y, slot->mTexture.width * scale, slot->mTexture.height * scale};
-            Vector2 origin = {};
+            ::Rectangle source = slot->getSourceRect();
+            ::Rectangle dest = {drawPos.x, drawPos.y, slot->getWidth() * scale, slot->getHeight() * scale};
             
             if (doFlip)
             {
-               source.x = (float)slot->mTexture.width;
-               source.width = -(float)slot->mTexture.width;
+               // NOTE: negative width flips within the same source area
+               source.width = -source.width;
             }
             
-            if ((frame.setFlags & SimWorld::ImageSet::FLAG_TRANSPARENT) != 0)
-            {
-               BeginBlendMode(BLEND_ALPHA);
-            }
-            
-            DrawTexturePro(slot->mTexture, source, dest, origin, 0.0f, WHITE);
-            
-            if ((frame.setFlags & SimWorld::ImageSet::FLAG_TRANSPARENT) != 0)
-            {
-               EndBlendMode();
-            }
+            gSpriteBatch.submit(slot->mTexture, source, dest, tint,
+                                (frame.setFlags & SimWorld::ImageSet::FLAG_TRANSPARENT) != 0 ? BLEND_ALPHA : SpriteBatch::BLEND_INHERIT);
          }
       }
    }
@@ -142,6 +142,7 @@ struct CostumeRenderer
         Point2F position; // display position
         Point2F delta;    // momentum
         F32 scale;
+        U8 maskLayer;     // z plane mask to apply, passed to the mask shader in the vertex alpha
         std::vector<LimbState> mLimbState;
 
        void init(StaticState& state);
@@ -163,6 +164,8 @@ struct CostumeRenderer
        S32 lookupAnim(StaticState& state, StringTableEntry animName);
        
        bool isAnimPlaying(StaticState& state, U32 animIdx);
+       
+       bool isAnimating() const; // any limb still has commands to run
     };
 };
 
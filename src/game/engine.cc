@@ -53,6 +53,8 @@ void UtilDrawOutlinedText(const char *text, S32 posX, S32 posY, S32 fontSize, Co
 
 void UtilDrawTextLines(const char *text, Point2I pos, int fontSize, int lineSpacing, bool centered, Color color)
 {
+   PROFILE_SCOPE("DrawTextLines");
+   
    static const U32 MaxLines = 10;
    
    struct LineInfo
@@ -260,8 +262,23 @@ RaylibInputRouter::~RaylibInputRouter()
    
 }
 
+void RaylibInputRouter::dispatch()
+{
+   mHadInput = true;
+   
+   if (gGlobals.inputRecorder)
+   {
+      gGlobals.inputRecorder->recordEvent(gGlobals.simTick, mLastEvent);
+   }
+   
+   mRoot->processInput(mLastEvent);
+}
+
 void RaylibInputRouter::update(Camera2D& cam)
 {
+   PROFILE_SCOPE("Input");
+   
+   mHadInput = false;
    if (!mRoot) return;
    
    const Vector2 mouseR = GetMousePosition();
@@ -282,7 +299,7 @@ void RaylibInputRouter::update(Camera2D& cam)
       mLastEvent.mouse.button = -1;
       mLastEvent.mouse.wheelPos = 0.0f;
       
-      mRoot->processInput(mLastEvent);
+      dispatch();
       
       mLastMouse = mouse;
    }
@@ -297,7 +314,7 @@ void RaylibInputRouter::update(Camera2D& cam)
       mLastEvent.mouse.button = -1;
       mLastEvent.mouse.wheelPos = wheel;
       
-      mRoot->processInput(mLastEvent);
+      dispatch();
    }
    
    for (int b = 0; b <= MOUSE_BUTTON_MIDDLE; ++b)
@@ -313,7 +330,7 @@ void RaylibInputRouter::update(Camera2D& cam)
          mLastEvent.mouse.button = b;
          mLastEvent.mouse.wheelPos = 0.0f;
          
-         mRoot->processInput(mLastEvent);
+         dispatch();
       }
    }
    
@@ -330,7 +347,7 @@ void RaylibInputRouter::update(Camera2D& cam)
             mLastEvent.mouse.button = b;
             mLastEvent.mouse.wheelPos = 0.0f;
             
-            mRoot->processInput(mLastEvent);
+            dispatch();
             
             it = mActiveMouseButtons.erase(it);
          }
@@ -349,7 +366,7 @@ void RaylibInputRouter::update(Camera2D& cam)
       mLastEvent.handled = false;
       mLastEvent.keys.key = (U32)k;
       
-      mRoot->processInput(mLastEvent);
+      dispatch();
    }
    
    if (!mActiveKeys.empty())
@@ -363,7 +380,7 @@ void RaylibInputRouter::update(Camera2D& cam)
             mLastEvent.handled = false;
             mLastEvent.keys.key = (U32)k;
             
-            mRoot->processInput(mLastEvent);
+            dispatch();
             
             it = mActiveKeys.erase(it);
          }
@@ -380,7 +397,7 @@ void RaylibInputRouter::update(Camera2D& cam)
       mLastEvent.handled = false;
       mLastEvent.keys.codePoint = (U32)cp;
       
-      mRoot->processInput(mLastEvent);
+      dispatch();
    }
 }
 
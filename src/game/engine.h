@@ -25,6 +25,14 @@
 #include <vector>
 #include <cstdint>
 #include <algorithm>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <queue>
 
 #include "platform/platformProcess.h"
 
@@ -45,6 +53,7 @@
 // raylib stuff
 
 #include "raylib.h"
+#include "rlgl.h"
 #include "raygui.h"
 
 
@@ -151,6 +160,13 @@ struct DBIEvent
     pad.v2 = 0;
     pad.v3 = 0;
    }
+
+   DBIEvent(const DBIEvent& other)
+   {
+    *this = other;
+   }
+
+   DBIEvent& operator=(const DBIEvent& other) = default;
 };
 
 struct MessageDisplayParams
@@ -229,13 +245,18 @@ END_SW_NS
 
 #include "scheduling.h"
 #include "displayBase.h"
+#include "boxKernels.h"
+#include "walkMap.h"
 #include "resources.h"
 #include "resourceManagers.h"
+#include "spriteBatch.h"
 #include "costume.h"
 #include "actor.h"
 #include "room.h"
 #include "sound.h"
 #include "verbs.h"
+#include "inputReplay.h"
+#include "profiler.h"
 
 
 DefineConsoleType( TypeColor )
@@ -244,6 +265,8 @@ DefineConsoleType( TypeColor )
 // globals
 
 extern F32 gTimerNext;
+extern S32 gMouseX;
+extern S32 gMouseY;
 
 extern SimFiberManager* gFiberManager;
 extern TextureManager* gTextureManager;
@@ -319,12 +342,17 @@ public:
    ~RaylibInputRouter();
 
     void update(Camera2D& cam);
+    
+    inline bool hadInput() const { return mHadInput; } // events sent by the last update
 
 private:
+    void dispatch();
+
     SimWorld::DisplayBase* mRoot = nullptr;
     Point2I mLastMouse{};
 
     DBIEvent mLastEvent;
+    bool mHadInput = false;
 
     std::unordered_set<int> mActiveKeys;
     std::unordered_set<int> mActiveMouseButtons;
@@ -340,22 +368,30 @@ struct EngineGlobals
 
    SimWorld::SentenceQueueManager* sentenceQueue;
    RaylibInputRouter* inputHandler;
+   InputRecorder* inputRecorder;
+   InputReplayer* inputReplayer;
 
    KorkApi::FiberId sentenceFiber;
    ActiveMessage currentMessage;
    
    RenderTexture2D roomRt;
-   RenderTexture2D roomZPlaneRt[SimWorld::RoomRender::NumZPlanes];
+   RenderTexture2D roomZPlaneRt;    // z plane N is stored in channel N (RGB)
+   SimWorld::Room* roomZPlaneOwner; // room roomZPlaneRt was last built for
    Shader shaderMask;
 
    F32 mChannelVolume[AUDIO_CHANNEL_COUNT];
 
    U32 messageSpeed;
+   U32 simTick;      // fixed ticks run since boot
+   F32 renderAlpha;  // how far into the next fixed tick this frame is, 0-1
+   U32 lastBusyTick; // last simTick where anything on screen could have changed
    
    Point2I screenSize;
    
    bool userPut;
    bool cursorState;
+   bool headless;    // no window, audio device or GPU resources
+   bool lowPower;    // sleep between frames and don't redraw a still scene
 
    void setActiveMessage(MessageDisplayParams params, SimWorld::Actor* actor, SimWorld::Sound* sound, StringTableEntry message, bool isTalk, U32 ovrTicks);
 };
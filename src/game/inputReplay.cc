@@ -0,0 +1,208 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+#include "engine.h"
+
+
+bool InputRecord::write(Stream& stream, const InputRecord& record)
+{
+   const DBIEvent& event = record.event;
+
+   stream.write(record.tick);
+   stream.write((U8)event.type);
+
+   switch (event.type)
+   {
+      case UI_EVENT_MOUSE_MOVE:
+      case UI_EVENT_MOUSE_DOWN:
+      case UI_EVENT_MOUSE_UP:
+      case UI_EVENT_MOUSE_WHEEL:
+         stream.write((S16)event.mouse.pos.x);
+         stream.write((S16)event.mouse.pos.y);
+         stream.write((S8)event.mouse.button);
+         stream.write(event.mouse.wheelPos);
+         break;
+      case UI_EVENT_KEY_DOWN:
+      case UI_EVENT_KEY_UP:
+         stream.write(event.keys.key);
+         break;
+      case UI_EVENT_CHAR:
+         stream.write(event.keys.codePoint);
+         break;
+   }
+
+   return stream.getStatus() == Stream::Ok;
+}
+
+bool InputRecord::read(Stream& stream, InputRecord& record)
+{
+   U8 type = 0;
+
+   if (!stream.read(&record.tick) ||
+       !stream.read(&type))
+   {
+      return false;
+   }
+
+   record.event = DBIEvent();
+   record.event.type = (DBIEventType)type;
+   record.event.handled = false;
+   record.event.capturedControl = nullptr;
+
+   // A record cut short by the end of the file is dropped
+   switch (record.event.type)
+   {
+      case UI_EVENT_MOUSE_MOVE:
+      case UI_EVENT_MOUSE_DOWN:
+      case UI_EVENT_MOUSE_UP:
+      case UI_EVENT_MOUSE_WHEEL:
+      {
+         S16 x = 0;
+         S16 y = 0;
+         S8 button = 0;
+         if (!stream.read(&x) ||
+             !stream.read(&y) ||
+             !stream.read(&button) ||
+             !stream.read(&record.event.mouse.wheelPos))
+         {
+            return false;
+         }
+         record.event.mouse.pos = Point2I(x, y);
+         record.event.mouse.button = button;
+         break;
+      }
+      case UI_EVENT_KEY_DOWN:
+      case UI_EVENT_KEY_UP:
+         if (!stream.read(&record.event.keys.key))
+         {
+            return false;
+         }
+         break;
+      case UI_EVENT_CHAR:
+         if (!stream.read(&record.event.keys.codePoint))
+         {
+            return false;
+         }
+         break;
+      default:
+         return false;
+   }
+
+   return true;
+}
+
+
+InputRecorder::InputRecorder() : mOpen(false)
+{
+}
+
+InputRecorder::~InputRecorder()
+{
+   close();
+}
+
+bool InputRecorder::open(const char* path)
+{
+   close();
+
+   if (!mStream.open(path, FileStream::Write))
+   {
+      Con::errorf("InputRecorder: couldn't open %s for writing", path);
+      return false;
+   }
+
+   mStream.write((U32)InputRecord::FileMagic);
+   mStream.write((U32)InputRecord::FileVersion);
+   mOpen = true;
+   return true;
+}
+
+void InputRecorder::close()
+{
+   if (mOpen)
+   {
+      mStream.close();
+      mOpen = false;
+   }
+}
+
+void InputRecorder::recordEvent(U32 tick, const DBIEvent& event)
+{
+   if (!mOpen)
+      return;
+
+   InputRecord record;
+   record.tick = tick;
+   record.event = event;
+   InputRecord::write(mStream, record);
+}
+
+
+InputReplayer::InputReplayer() : mNext(0)
+{
+   mLastEvent.capturedControl = nullptr;
+}
+
+bool InputReplayer::open(const char* path)
+{
+   FileStream fs;
+   if (!fs.open(path, FileStream::Read))
+   {
+      Con::errorf("InputReplayer: couldn't open %s", path);
+      return false;
+   }
+
+   U32 magic = 0;
+   U32 version = 0;
+   fs.read(&magic);
+   fs.read(&version);
+
+   if (magic != InputRecord::FileMagic || version != InputRecord::FileVersion)
+   {
+      Con::errorf("InputReplayer: %s is not a valid input recording", path);
+      return false;
+   }
+
+   mRecords.clear();
+   mNext = 0;
+
+   InputRecord record;
+   while (InputRecord::read(fs, record))
+   {
+      mRecords.push_back(record);
+   }
+
+   Con::printf("InputReplayer: loaded %u events from %s", (U32)mRecords.size(), path);
+   return true;
+}
+
+void InputReplayer::dispatch(U32 tick, SimWorld::DisplayBase* root)
+{
+   while (mNext < mRecords.size() && mRecords[mNext].tick <= tick)
+   {
+      const InputRecord& record = mRecords[mNext++];
+
+      // Same capture handling as RaylibInputRouter
+      SimWorld::DisplayBase* capturedControl = mLastEvent.capturedControl;
+      mLastEvent = record.event;
+      mLastEvent.capturedControl = capturedControl;
+      mLastEvent.handled = false;
+
+      // Virtual mouse follows the recorded cursor
+      if (mLastEvent.type == UI_EVENT_MOUSE_MOVE)
+      {
+         gMouseX = mLastEvent.mouse.pos.x;
+         gMouseY = mLastEvent.mouse.pos.y;
+      }
+
+      if (root)
+      {
+         root->processInput(mLastEvent);
+      }
+   }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+
+// Input sessions are stored as a stream of DBIEvents, each tagged with the
+// fixed sim tick it was delivered before. Layout:
+//
+//    U32 magic ('OQIR')
+//    U32 version
+//    Record[]
+//       U32 tick
+//       U8  type (DBIEventType)
+//       mouse events: S16 x, S16 y, S8 button, F32 wheel
+//       key events:   U32 key
+//       char events:  U32 codePoint
+//
+struct InputRecord
+{
+   enum
+   {
+      FileMagic = 0x5249514F, // OQIR
+      FileVersion = 1
+   };
+
+   U32 tick;
+   DBIEvent event;
+
+   static bool write(Stream& stream, const InputRecord& record);
+   static bool read(Stream& stream, InputRecord& record);
+};
+
+// Saves every event the input router delivers
+class InputRecorder
+{
+public:
+   InputRecorder();
+   ~InputRecorder();
+
+   bool open(const char* path);
+   void close();
+
+   void recordEvent(U32 tick, const DBIEvent& event);
+
+private:
+   FileStream mStream;
+   bool mOpen;
+};
+
+// Feeds a recorded session back through the root UI
+class InputReplayer
+{
+public:
+   InputReplayer();
+
+   bool open(const char* path);
+
+   // Delivers all events recorded for ticks up to and including tick
+   void dispatch(U32 tick, SimWorld::DisplayBase* root);
+
+   inline bool isFinished() const { return mNext >= mRecords.size(); }
+   inline U32 getLastTick() const { return mRecords.empty() ? 0 : mRecords.back().tick; }
+
+private:
+   std::vector<InputRecord> mRecords;
+   size_t mNext;
+   DBIEvent mLastEvent;
+};
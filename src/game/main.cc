@@ -13,6 +13,9 @@
 #define TICK_HZ        60.0        // fixed simulation rate (e.g. 60, 64, 128)
 #define MAX_FRAME_DT   0.25         // clamp to avoid spiral-of-death (seconds)
 #define MAX_STEPS      8            // safety cap: max sim steps per render frame
+#define UPLOAD_BUDGET_MS 2.0        // time per frame spent uploading decoded textures
+#define IDLE_REDRAW_SECS 1.0        // low power: redraw a still scene at least this often
+#define STILL_TICKS    10           // low power: quiet ticks before a scene counts as still
 
 
 
@@ -56,18 +59,213 @@ static Rectangle GetLetterboxViewport(int sw, int sh, int vw, int vh)
 }
 
 
+static void UpdateRootLayout()
+{
+   if (SimWorld::RootUI::sMainInstance)
+   {
+      SimWorld::RootUI::sMainInstance->resize(Point2I(0,0), SimWorld::RootUI::sMainInstance->mMinContentSize);
+      SimWorld::RootUI::sMainInstance->updateLayout(RectI(Point2I(0,0), SimWorld::RootUI::sMainInstance->mMinContentSize));
+   }
+}
+
+// FNV-1a over every ticking actor's id and position, in id order. Two runs of
+// the same recording should always produce the same value.
+static void CollectActors(SimGroup* group, std::vector<SimWorld::Actor*>& outActors)
+{
+   for (SimObject* obj : group->objectList)
+   {
+      SimWorld::Room* room = dynamic_cast<SimWorld::Room*>(obj);
+      if (room)
+      {
+         outActors.insert(outActors.end(), room->mActorList.mActors.begin(), room->mActorList.mActors.end());
+         continue;
+      }
+      
+      SimGroup* childGroup = dynamic_cast<SimGroup*>(obj);
+      if (childGroup)
+      {
+         CollectActors(childGroup, outActors);
+      }
+   }
+}
+
+static U32 ComputeActorChecksum()
+{
+   std::vector<SimWorld::Actor*> actors;
+   CollectActors(Sim::getRootGroup(), actors);
+   
+   std::sort(actors.begin(), actors.end(), [](SimWorld::Actor* a, SimWorld::Actor* b){
+      return a->getId() < b->getId();
+   });
+   
+   U32 hash = 2166136261u;
+   auto mix = [&hash](S32 value) {
+      for (U32 i=0; i<4; i++)
+      {
+         hash ^= (U8)(value >> (i*8));
+         hash *= 16777619u;
+      }
+   };
+   
+   for (SimWorld::Actor* actor : actors)
+   {
+      mix((S32)actor->getId());
+      mix(actor->mAnchor.x);
+      mix(actor->mAnchor.y);
+   }
+   
+   return hash;
+}
+
+// True if nothing on screen can have changed this tick, apart from fibers
+// which mark themselves busy when they run or are due to resume.
+static bool IsSceneStill()
+{
+   if (gGlobals.currentMessage.ticking ||
+       gGlobals.inputReplayer ||
+       gProfiler.mShowOverlay ||
+       (gGlobals.inputHandler && gGlobals.inputHandler->hadInput()))
+   {
+      return false;
+   }
+   
+   SimWorld::Room* room = gGlobals.currentRoom;
+   if (!room)
+   {
+      return true;
+   }
+   
+   if (!room->mRenderState.transitionEnded ||
+       room->mRenderState.mTexturesPending)
+   {
+      return false;
+   }
+   
+   for (SimWorld::Actor* actor : room->mActorList.mActors)
+   {
+      if (actor->mWalkState.mAction >= SimWorld::ActorWalkState::ACTION_CHECK_MOVE ||
+          actor->mPrevAnchor != actor->mAnchor ||
+          (actor->mCostume && actor->mLiveCostume.isAnimating()))
+      {
+         return false;
+      }
+   }
+   
+   return true;
+}
+
+// Runs the fixed-step simulation as fast as possible with no window, audio or
+// render targets. Used to get a ticks/sec baseline for scripted scenes.
+static void RunHeadless(U32 maxTicks)
+{
+   gGlobals.userPut = true;
+   gGlobals.cursorState = true;
+   
+   gTextureManager = new TextureManager();
+   
+   // Boot
+   Con::executef("exec", KorkApi::ConsoleValue::makeString("boot.cs"));
+   
+   // Always play out the full recording
+   if (gGlobals.inputReplayer)
+   {
+      maxTicks = getMax(maxTicks, gGlobals.inputReplayer->getLastTick() + 1);
+   }
+   
+   const float fixedDt = 1.0f / (((float)TICK_HZ) / gTimerNext);
+   std::vector<F64> tickTimes;
+   tickTimes.reserve(maxTicks);
+   
+   auto startTime = std::chrono::steady_clock::now();
+   U32 ticks = 0;
+   
+   while (ticks < maxTicks)
+   {
+      auto tickStart = std::chrono::steady_clock::now();
+      
+      if (SimWorld::RootUI::sMainInstance)
+      {
+         SimWorld::RootUI::sMainInstance->mAnchor = Point2I(0,0);
+         SimWorld::RootUI::sMainInstance->mMinContentSize = Point2I(320, 200);
+      }
+      
+      UpdateRootLayout();
+      
+      if (gGlobals.inputReplayer)
+      {
+         gGlobals.inputReplayer->dispatch(gGlobals.simTick, SimWorld::RootUI::sMainInstance);
+      }
+      
+      ITickable::doFixedTick(fixedDt);
+      {
+         PROFILE_SCOPE("Fibers");
+         NoteDueFiberWakes(gFiberManager->getCurrentTick() + 1);
+         gFiberManager->execFibers(1);
+      }
+      gGlobals.simTick++;
+      gGlobals.sentenceQueue->execItem();
+      ticks++;
+      
+      tickTimes.push_back(std::chrono::duration<F64, std::micro>(std::chrono::steady_clock::now() - tickStart).count());
+   }
+   
+   F64 elapsed = std::chrono::duration<F64>(std::chrono::steady_clock::now() - startTime).count();
+   Con::printf("Headless: %u ticks in %.3fs (%.1f ticks/sec)", ticks, elapsed, elapsed > 0.0 ? ticks / elapsed : 0.0);
+   
+   if (!tickTimes.empty())
+   {
+      std::sort(tickTimes.begin(), tickTimes.end());
+      const size_t count = tickTimes.size();
+      Con::printf("Headless: tick cost p50=%.1fus p99=%.1fus max=%.1fus",
+                  tickTimes[count / 2],
+                  tickTimes[getMin(count - 1, (count * 99) / 100)],
+                  tickTimes[count - 1]);
+   }
+   
+   Con::printf("Headless: actor checksum %08x", ComputeActorChecksum());
+}
+
+
 int main(int argc, char **argv)
 {
    const int screenWidth = 800;
    const int screenHeight = 450;
    
+   U32 headlessTicks = 3600;
+   const char* recordPath = nullptr;
+   const char* replayPath = nullptr;
+   
+   for (int i=1; i<argc; i++)
+   {
+      if (strcmp(argv[i], "--headless") == 0)
+      {
+         gGlobals.headless = true;
+      }
+      else if (strcmp(argv[i], "--lowpower") == 0)
+      {
+         gGlobals.lowPower = true;
+      }
+      else if (strcmp(argv[i], "--ticks") == 0 && i+1 < argc)
+      {
+         headlessTicks = (U32)atoi(argv[++i]);
+      }
+      else if (strcmp(argv[i], "--record") == 0 && i+1 < argc)
+      {
+         recordPath = argv[++i];
+      }
+      else if (strcmp(argv[i], "--replay") == 0 && i+1 < argc)
+      {
+         replayPath = argv[++i];
+      }
+   }
+   
    Con::init();
    Sim::init();
    Con::addConsumer(MyLogger, nullptr);
    
    gFiberManager = new SimFiberManager();
    gFiberManager->registerObject("FiberManager");
-   gGlobals.engineTick.registerTickable();
+   gGlobals.engineTick.registerTickable(ITickable::TICK_SCRIPT);
 
    gGlobals.sentenceQueue = new SimWorld::SentenceQueueManager();
    gGlobals.sentenceQueue->registerObject("SentenceQueue");
@@ -76,6 +274,38 @@ int main(int argc, char **argv)
    Con::addVariable("$VAR_HAVE_MSG", TypeBool, &gGlobals.currentMessage.ticking);
    Con::addVariable("$VAR_VIRT_MOUSE_X", TypeS32, &gMouseX);
    Con::addVariable("$VAR_VIRT_MOUSE_Y", TypeS32, &gMouseY);
+   Con::addVariable("$LOW_POWER", TypeBool, &gGlobals.lowPower);
+   
+   if (replayPath)
+   {
+      gGlobals.inputReplayer = new InputReplayer();
+      if (!gGlobals.inputReplayer->open(replayPath))
+      {
+         delete gGlobals.inputReplayer;
+         gGlobals.inputReplayer = nullptr;
+      }
+   }
+   else if (recordPath && !gGlobals.headless)
+   {
+      gGlobals.inputRecorder = new InputRecorder();
+      if (!gGlobals.inputRecorder->open(recordPath))
+      {
+         delete gGlobals.inputRecorder;
+         gGlobals.inputRecorder = nullptr;
+      }
+   }
+   
+   if (gGlobals.headless)
+   {
+      RunHeadless(headlessTicks);
+      
+      delete gGlobals.inputReplayer;
+      Con::shutdown();
+      Sim::shutdown();
+      
+      gGlobals.engineTick.unregisterTickable();
+      return 0;
+   }
    
    ClearWindowState(FLAG_VSYNC_HINT);
    
@@ -98,19 +328,21 @@ int main(int argc, char **argv)
    "\n"
    "void main()\n"
    "{\n"
-   "    vec4 actor = texture(texture0, fragTexCoord) * fragColor;\n"
+   "    // vertex alpha encodes the z plane layer (255 - layer)\n"
+   "    float layer = floor((1.0 - fragColor.a) * 255.0 + 0.5);\n"
+   "    vec4 actor = texture(texture0, fragTexCoord) * vec4(fragColor.rgb, 1.0);\n"
    "\n"
    "    vec2 p = vec2(gl_FragCoord.x, gl_FragCoord.y);\n"
    "\n"
    "    vec2 uv = p / roomSizePx;\n"
-   "    vec4 m = vec4(0.0);\n"
+   "    vec3 m = vec3(0.0);\n"
    "    if (uv.x >= 0.0 && uv.x <= 1.0 && uv.y >= 0.0 && uv.y <= 1.0)\n"
    "    {\n"
-   "        m = texture(maskTex, uv);   // 1.0 = white = hide actor\n"
+   "        m = texture(maskTex, uv).rgb;   // 1.0 = white = hide actor\n"
    "    }\n"
    "\n"
-   "    actor.a *= 1.0-m.r;\n"
-   "    //actor.rgba = vec4(m.r,m.r,m.r,1.0);\n"
+   "    vec3 sel = vec3(equal(vec3(layer), vec3(1.0, 2.0, 3.0)));\n"
+   "    actor.a *= 1.0-dot(m, sel);\n"
    "\n"
    "    finalColor = actor;\n"
    "}\n";
@@ -133,10 +365,9 @@ int main(int argc, char **argv)
       gGlobals.cursorState = true;
       
       gGlobals.roomRt = LoadRenderTexture(320, 200);
-      for (U32 zPlane=0; zPlane<SimWorld::RoomRender::NumZPlanes; zPlane++)
-      {
-         gGlobals.roomZPlaneRt[zPlane] = LoadRenderTexture(320, 200);
-      }
+      gGlobals.roomZPlaneRt = LoadRenderTexture(320, 200);
+      SetTextureFilter(gGlobals.roomZPlaneRt.texture, TEXTURE_FILTER_POINT);
+      SetTextureWrap(gGlobals.roomZPlaneRt.texture, TEXTURE_WRAP_CLAMP);
       SetTextureFilter(gGlobals.roomRt.texture, TEXTURE_FILTER_POINT);
       
       Rectangle vp = GetLetterboxViewport(screenWidth, screenHeight, 320, 200);
@@ -153,9 +384,24 @@ int main(int argc, char **argv)
       const float fixedDt = 1.0f / (((float)TICK_HZ) / gTimerNext);
       double accumulator = fixedDt;
       
+      double lastFrameTime = GetTime();
+      double lastRenderTime = 0.0;
+      U32 lastUploadGeneration = gTextureManager->getUploadGeneration();
+      bool drawnStill = false; // last drawn frame already shows the still scene
+      
       while (!WindowShouldClose())
       {
-         float frameDt = GetFrameTime();
+         gProfiler.beginFrame();
+         
+         if (IsKeyPressed(KEY_F3))
+         {
+            gProfiler.mShowOverlay = !gProfiler.mShowOverlay;
+         }
+         
+         // Frames can be skipped in low power mode, which leaves GetFrameTime stale
+         const double frameStart = GetTime();
+         float frameDt = (float)(frameStart - lastFrameTime);
+         lastFrameTime = frameStart;
          if (frameDt > (float)MAX_FRAME_DT) frameDt = (float)MAX_FRAME_DT;
          accumulator += frameDt;
          
@@ -170,22 +416,21 @@ int main(int argc, char **argv)
             SimWorld::RootUI::sMainInstance->mMinContentSize = Point2I(320, 200);
          }
          
-         // Update globals
-         gMouseX = GetMouseX() - vp.x;
-         gMouseY = GetMouseY() - vp.y;
-         
-         // Need these translated into room space
-         gMouseX = ((F32)gMouseX / vp.width) * 320.0;
-         gMouseY = ((F32)gMouseY / vp.height) * 200.0;
-         
-         // Pre-frame layout update
-         if (SimWorld::RootUI::sMainInstance)
+         // Update globals (replays drive the virtual mouse themselves)
+         if (!gGlobals.inputReplayer)
          {
-            SimWorld::RootUI::sMainInstance->resize(Point2I(0,0), SimWorld::RootUI::sMainInstance->mMinContentSize);
-            SimWorld::RootUI::sMainInstance->updateLayout(RectI(Point2I(0,0), SimWorld::RootUI::sMainInstance->mMinContentSize));
+            gMouseX = GetMouseX() - vp.x;
+            gMouseY = GetMouseY() - vp.y;
+            
+            // Need these translated into room space
+            gMouseX = ((F32)gMouseX / vp.width) * 320.0;
+            gMouseY = ((F32)gMouseY / vp.height) * 200.0;
          }
+         
+         // Pre-frame layout update
+         UpdateRootLayout();
 
-         if (gGlobals.userPut)
+         if (gGlobals.userPut && !gGlobals.inputReplayer)
          {
             gGlobals.inputHandler->update(cam);
          }
@@ -194,37 +439,101 @@ int main(int argc, char **argv)
          int steps = 0;
          while (accumulator >= fixedDt && steps < MAX_STEPS)
          {
+            if (gGlobals.inputReplayer)
+            {
+               gGlobals.inputReplayer->dispatch(gGlobals.simTick, SimWorld::RootUI::sMainInstance);
+            }
+            
             ITickable::doFixedTick(fixedDt);
-            gFiberManager->execFibers(1);
+            {
+               PROFILE_SCOPE("Fibers");
+               NoteDueFiberWakes(gFiberManager->getCurrentTick() + 1);
+               gFiberManager->execFibers(1);
+            }
+            gGlobals.simTick++;
+            gGlobals.sentenceQueue->execItem();
             accumulator -= fixedDt;
             steps++;
          }
-
-         gGlobals.sentenceQueue->execItem();
          
-         BeginDrawing();
+         // Leftover time is drawn by blending towards the next tick
+         gGlobals.renderAlpha = (F32)std::min(accumulator / fixedDt, 1.0);
          
-         ClearBackground(BLACK);
-         BeginMode2D(cam);
+         // Finish off textures decoded in the background, then upload
+         // anything packed into the atlas since last frame
+         gTextureManager->processUploads(UPLOAD_BUDGET_MS);
+         gTextureManager->flushAtlasPages();
          
-         if (SimWorld::RootUI::sMainInstance)
+         if (!IsSceneStill() ||
+             gTextureManager->getUploadGeneration() != lastUploadGeneration)
+         {
+            gGlobals.lastBusyTick = gGlobals.simTick;
+         }
+         lastUploadGeneration = gTextureManager->getUploadGeneration();
+         const bool sceneStill = gGlobals.simTick - gGlobals.lastBusyTick > STILL_TICKS;
+         
+         if (gGlobals.lowPower &&
+             sceneStill &&
+             drawnStill &&
+             frameStart - lastRenderTime < IDLE_REDRAW_SECS)
          {
-            SimWorld::RootUI::sMainInstance->onRender(Point2I(0,0), RectI(Point2I(0,0), Point2I(320, 200)), cam);
+            // Nothing has changed; leave the last frame up and just take input
+            PollInputEvents();
          }
+         else
+         {
+            drawnStill = sceneStill;
+            lastRenderTime = frameStart;
+         
+            BeginDrawing();
          
-         //DrawText(TextFormat("Sim tick: %.0f Hz (dt=%.6f) FPS=%i", ((float)TICK_HZ) / gTimerNext, fixedDt, GetFPS()), 10, 10, 20, DARKGRAY);
-         //DrawText(TextFormat("steps=%d", steps), 10, 35, 20, DARKGRAY);
+            ClearBackground(BLACK);
+            BeginMode2D(cam);
          
-         EndMode2D();
+            if (SimWorld::RootUI::sMainInstance)
+            {
+               PROFILE_SCOPE("Render");
+               SimWorld::RootUI::sMainInstance->onRender(Point2I(0,0), RectI(Point2I(0,0), Point2I(320, 200)), cam);
+            }
          
-         // Debug viewport outline
-         DrawRectangleLinesEx(vp, 1, GREEN);
+            //DrawText(TextFormat("Sim tick: %.0f Hz (dt=%.6f) FPS=%i", ((float)TICK_HZ) / gTimerNext, fixedDt, GetFPS()), 10, 10, 20, DARKGRAY);
+            //DrawText(TextFormat("steps=%d", steps), 10, 35, 20, DARKGRAY);
          
-         EndDrawing();
+            EndMode2D();
+         
+            // Debug viewport outline
+            DrawRectangleLinesEx(vp, 1, GREEN);
+         
+            gProfiler.renderOverlay();
+         
+            EndDrawing();
+         }
+         
+         if (gGlobals.lowPower)
+         {
+            // Sleep until the next tick is due, or the next refresh while
+            // anything is moving
+            double wakeTime = frameStart + (fixedDt - accumulator);
+            if (!sceneStill)
+            {
+               const S32 refreshRate = GetMonitorRefreshRate(GetCurrentMonitor());
+               wakeTime = std::min(wakeTime, frameStart + (1.0 / (refreshRate > 0 ? refreshRate : 60)));
+            }
+            
+            const double waitTime = wakeTime - GetTime();
+            if (waitTime > 0.0)
+            {
+               WaitTime(waitTime);
+            }
+         }
       }
    }
    
+   gTextureManager->stopWorker();
+   
    delete gGlobals.inputHandler;
+   delete gGlobals.inputRecorder;
+   delete gGlobals.inputReplayer;
    Con::shutdown();
    Sim::shutdown();
    
@@ -0,0 +1,173 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+#include "engine.h"
+
+
+Profiler gProfiler;
+
+Profiler::Profiler() :
+mShowOverlay(false),
+mCapturing(false),
+mDepth(0),
+mLastFrameUs(0.0)
+{
+   mEpoch = Clock::now();
+   mFrameStart = mEpoch;
+}
+
+void Profiler::beginFrame()
+{
+   Clock::time_point now = Clock::now();
+   mLastFrameUs = std::chrono::duration<F64, std::micro>(now - mFrameStart).count();
+   mFrameStart = now;
+
+   // Keep zone slots so indices stay stable, just reset the counters
+   mLastZones = mCurrentZones;
+   for (ZoneStats& zone : mCurrentZones)
+   {
+      zone.totalUs = 0.0;
+      zone.calls = 0;
+   }
+}
+
+U32 Profiler::enterZone(const char* name)
+{
+   U32 depth = mDepth++;
+
+   for (U32 i=0; i<mCurrentZones.size(); i++)
+   {
+      ZoneStats& zone = mCurrentZones[i];
+      if (zone.depth == depth && (zone.name == name || strcmp(zone.name, name) == 0))
+      {
+         return i;
+      }
+   }
+
+   ZoneStats zone;
+   zone.name = name;
+   zone.totalUs = 0.0;
+   zone.calls = 0;
+   zone.depth = depth;
+   mCurrentZones.push_back(zone);
+   return (U32)(mCurrentZones.size() - 1);
+}
+
+void Profiler::exitZone(U32 index, Clock::time_point start, Clock::time_point end)
+{
+   mDepth--;
+
+   ZoneStats& zone = mCurrentZones[index];
+   F64 durationUs = std::chrono::duration<F64, std::micro>(end - start).count();
+   zone.totalUs += durationUs;
+   zone.calls++;
+
+   if (mCapturing && mTrace.size() < MaxTraceEvents)
+   {
+      TraceEvent event;
+      event.name = zone.name;
+      event.startUs = std::chrono::duration<F64, std::micro>(start - mEpoch).count();
+      event.durationUs = durationUs;
+      mTrace.push_back(event);
+   }
+}
+
+void Profiler::startCapture()
+{
+   mTrace.clear();
+   mCapturing = true;
+}
+
+void Profiler::stopCapture()
+{
+   mCapturing = false;
+}
+
+bool Profiler::dumpTrace(const char* path)
+{
+   stopCapture();
+
+   FileStream fs;
+   if (!fs.open(path, FileStream::Write))
+   {
+      Con::errorf("Profiler: couldn't open %s for writing", path);
+      return false;
+   }
+
+   // Chrome trace event format, complete ("X") events on a single thread
+   std::string out = "{\"traceEvents\":[\n";
+   char buf[256];
+
+   for (size_t i=0; i<mTrace.size(); i++)
+   {
+      const TraceEvent& event = mTrace[i];
+      snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1}",
+               i == 0 ? "" : ",\n", event.name, event.startUs, event.durationUs);
+      out += buf;
+   }
+
+   out += "\n]}\n";
+   fs.write((U32)out.size(), out.c_str());
+   fs.close();
+
+   Con::printf("Profiler: wrote %u events to %s", (U32)mTrace.size(), path);
+   mTrace.clear();
+   return true;
+}
+
+void Profiler::renderOverlay()
+{
+   if (!mShowOverlay)
+      return;
+
+   const S32 lineHeight = 16;
+   const S32 width = 280;
+   const S32 height = (S32)(mLastZones.size() + 2) * lineHeight + 32;
+   Rectangle panel = { 10.0f, 10.0f, (float)width, (float)height };
+
+   GuiPanel(panel, "Profiler");
+
+   F32 y = panel.y + 28.0f;
+   GuiLabel((Rectangle){ panel.x + 8.0f, y, (float)width - 16.0f, (float)lineHeight },
+            TextFormat("Frame %.2fms  FPS %i", mLastFrameUs / 1000.0, GetFPS()));
+   y += lineHeight;
+
+   if (mCapturing)
+   {
+      GuiLabel((Rectangle){ panel.x + 8.0f, y, (float)width - 16.0f, (float)lineHeight },
+               TextFormat("Capturing trace (%u events)", (U32)mTrace.size()));
+   }
+   y += lineHeight;
+
+   for (const ZoneStats& zone : mLastZones)
+   {
+      F32 indent = 8.0f + zone.depth * 10.0f;
+      GuiLabel((Rectangle){ panel.x + indent, y, 160.0f, (float)lineHeight }, zone.name);
+      GuiLabel((Rectangle){ panel.x + 170.0f, y, (float)width - 178.0f, (float)lineHeight },
+               TextFormat("%6.3fms x%u", zone.totalUs / 1000.0, zone.calls));
+      y += lineHeight;
+   }
+}
+
+
+ConsoleFunctionValue(showProfiler, 2, 2, "(value)")
+{
+   gProfiler.mShowOverlay = vmPtr->valueAsBool(argv[1]);
+   return KorkApi::ConsoleValue();
+}
+
+ConsoleFunctionValue(startProfilerTrace, 1, 1, "")
+{
+   gProfiler.startCapture();
+   return KorkApi::ConsoleValue();
+}
+
+ConsoleFunctionValue(dumpProfilerTrace, 2, 2, "(fileName)")
+{
+   return KorkApi::ConsoleValue::makeUnsigned(gProfiler.dumpTrace(vmPtr->valueAsString(argv[1])));
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+
+// Scoped timing zones. Totals are collected per frame and the last full
+// frame is what the overlay shows. While a trace is being captured every
+// zone instance is also kept so it can be written out as Chrome trace JSON.
+class Profiler
+{
+public:
+   enum
+   {
+      MaxTraceEvents = 1 << 20
+   };
+
+   struct ZoneStats
+   {
+      const char* name;
+      F64 totalUs;
+      U32 calls;
+      U32 depth;
+   };
+
+   struct TraceEvent
+   {
+      const char* name;
+      F64 startUs;
+      F64 durationUs;
+   };
+
+   typedef std::chrono::steady_clock Clock;
+
+   bool mShowOverlay;
+   bool mCapturing;
+   U32 mDepth;
+
+   Profiler();
+
+   inline bool isEnabled() const { return mShowOverlay || mCapturing; }
+
+   void beginFrame();
+
+   U32 enterZone(const char* name);
+   void exitZone(U32 index, Clock::time_point start, Clock::time_point end);
+
+   void startCapture();
+   void stopCapture();
+   bool dumpTrace(const char* path);
+
+   void renderOverlay();
+
+private:
+   Clock::time_point mEpoch;
+   Clock::time_point mFrameStart;
+   F64 mLastFrameUs;
+
+   std::vector<ZoneStats> mCurrentZones;
+   std::vector<ZoneStats> mLastZones;
+   std::vector<TraceEvent> mTrace;
+};
+
+extern Profiler gProfiler;
+
+struct ProfilerZone
+{
+   Profiler::Clock::time_point mStart;
+   U32 mIndex;
+   bool mActive;
+
+   inline ProfilerZone(const char* name) : mIndex(0), mActive(gProfiler.isEnabled())
+   {
+      if (mActive)
+      {
+         mIndex = gProfiler.enterZone(name);
+         mStart = Profiler::Clock::now();
+      }
+   }
+
+   inline ~ProfilerZone()
+   {
+      if (mActive)
+      {
+         gProfiler.exitZone(mIndex, mStart, Profiler::Clock::now());
+      }
+   }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfilerZone PROFILE_CONCAT(_profileZone, __LINE__)(name)
@@ -9,44 +9,110 @@
 //
 
 
+U32 TextureSlot::smReleaseCounter = 0;
+
 TextureSlot* TextureHandle::getPtr() const
 {
     return gTextureManager->resolveHandle(*this);
 }
 
 
-TextureManager::TextureManager()
+TextureManager::TextureManager() :
+mStopWorker(false),
+mNextJobId(1),
+mUploadGeneration(0)
 {
-   
+   mStats = {};
+   mStats.budgetBytes = (U64)DefaultBudgetMB * 1024 * 1024;
+
+   // Headless loads stay synchronous so runs are repeatable
+   if (!gGlobals.headless)
+   {
+      mWorker = std::thread(&TextureManager::workerMain, this);
+   }
 }
 
 TextureManager::~TextureManager()
 {
+   stopWorker();
    cleanup();
 }
 
-TextureHandle TextureManager::loadTexture(const std::string& path, Image* existingImage)
+bool TextureAtlasPage::allocRect(S32 width, S32 height, RectI& outRect)
+{
+   const S32 paddedWidth = width + Padding;
+   const S32 paddedHeight = height + Padding;
+
+   // Start a new shelf if this row is full
+   if (mShelfX + paddedWidth > PageSize)
+   {
+      mShelfY += mShelfHeight;
+      mShelfX = 0;
+      mShelfHeight = 0;
+   }
+
+   if (mShelfX + paddedWidth > PageSize ||
+       mShelfY + paddedHeight > PageSize)
+   {
+      return false;
+   }
+
+   outRect = RectI(mShelfX, mShelfY, width, height);
+   mShelfX += paddedWidth;
+   mShelfHeight = getMax(mShelfHeight, paddedHeight);
+   return true;
+}
+
+
+TextureHandle TextureManager::loadTexture(const std::string& path, Image* existingImage, bool useAtlas)
 {
     // Already loaded?
-    auto it = mPathToId.find(path);
-    if (it != mPathToId.end()) {
-        U32 id = it->second;
-        return TextureHandle(id);
+    TextureHandle existing;
+    if (findLoaded(path, existing))
+    {
+       return existing;
     }
 
+    TextureSlot* slot = new TextureSlot();
+    slot->mPath = path;
+
     // Load new texture
-    ::Texture2D tex = existingImage ? ::LoadTextureFromImage(*existingImage) : ::LoadTexture(path.c_str());
+    if (gGlobals.headless)
+    {
+       // No GPU here, so just keep the dimensions around for layout
+       Image img = existingImage ? *existingImage : ::LoadImage(path.c_str());
+       slot->mTexture.width = img.width;
+       slot->mTexture.height = img.height;
+       slot->mTexture.mipmaps = img.mipmaps;
+       slot->mTexture.format = img.format;
+       slot->mSourceRect = RectI(0, 0, img.width, img.height);
+       slot->mBytes = ::GetPixelDataSize(img.width, img.height, img.format);
+       mStats.residentBytes += slot->mBytes;
+       if (!existingImage)
+       {
+          ::UnloadImage(img);
+       }
+    }
+    else
+    {
+       Image img = existingImage ? *existingImage : ::LoadImage(path.c_str());
+       if (img.data != NULL)
+       {
+          uploadImage(slot, img, useAtlas ? LOAD_ATLAS : 0);
+       }
+       if (!existingImage)
+       {
+          ::UnloadImage(img);
+       }
+    }
    
-    if (tex.id == 0)
+    if (slot->getWidth() == 0)
     {
        Con::errorf("Failed to load image '%s'", path.c_str());
+       delete slot;
        return TextureHandle();
     }
 
-    TextureSlot* slot = new TextureSlot();
-    slot->mTexture = tex;
-    slot->mPath = path;
-
     mTextureList.allocListHandle(slot, false);
 
     U32 newId = TextureHandle::makeValue(slot->mAllocNumber, slot->mGeneration, true);
@@ -54,14 +120,503 @@ TextureHandle TextureManager::loadTexture(const std::string& path, Image* existi
     return TextureHandle(slot);
 }
 
-void TextureManager::flushUnused()
+TextureHandle TextureManager::loadTextureAsync(const std::string& key, const std::string& filePath, U32 flags)
 {
-   mTextureList.forEach([this](TextureSlot* slot){
-      if (slot->mRefCount == 0)
+   TextureHandle existing;
+   if (findLoaded(key, existing))
+   {
+      return existing;
+   }
+
+   if (!Platform::isFile(filePath.c_str()))
+   {
+      Con::errorf("Failed to load image '%s'", filePath.c_str());
+      return TextureHandle();
+   }
+
+   if (!mWorker.joinable())
+   {
+      Image img = decodeImage(filePath, flags);
+      if (img.data == NULL)
+      {
+         Con::errorf("Failed to load image '%s'", filePath.c_str());
+         return TextureHandle();
+      }
+
+      TextureHandle handle = loadTexture(key, &img, (flags & LOAD_ATLAS) != 0);
+      ::UnloadImage(img);
+      return handle;
+   }
+
+   TextureSlot* slot = new TextureSlot();
+   slot->mPath = key;
+   slot->mPending = true;
+
+   mTextureList.allocListHandle(slot, false);
+
+   U32 newId = TextureHandle::makeValue(slot->mAllocNumber, slot->mGeneration, true);
+   mPathToId[key] = newId;
+
+   TextureHandle handle(slot);
+
+   DecodeJob job;
+   job.id = mNextJobId++;
+   job.flags = flags;
+   job.path = filePath;
+   job.image = {};
+
+   // Keeps the slot alive until it's uploaded
+   mPendingJobs[job.id] = handle;
+
+   {
+      std::lock_guard<std::mutex> lock(mJobMutex);
+      mJobQueue.push_back(job);
+   }
+   mJobSignal.notify_one();
+
+   return handle;
+}
+
+std::future<::Wave> TextureManager::loadWaveAsync(const std::string& filePath)
+{
+   DecodeJob job = {};
+   job.path = filePath;
+   job.wave = std::make_shared<std::promise<::Wave>>();
+   std::future<::Wave> result = job.wave->get_future();
+
+   if (!mWorker.joinable())
+   {
+      job.wave->set_value(::LoadWave(filePath.c_str()));
+      return result;
+   }
+
+   // Sounds are small and usually wanted soon, so they skip the image queue
+   {
+      std::lock_guard<std::mutex> lock(mJobMutex);
+      mJobQueue.push_front(job);
+   }
+   mJobSignal.notify_one();
+
+   return result;
+}
+
+bool TextureManager::findLoaded(const std::string& path, TextureHandle& outHandle)
+{
+   auto it = mPathToId.find(path);
+   if (it != mPathToId.end())
+   {
+      // Entry may outlive its slot if it was evicted by something else
+      TextureSlot* slot = resolveHandle(TextureHandle(it->second, false));
+      if (slot != NULL)
+      {
+         mStats.hits++;
+         outHandle = TextureHandle(slot);
+         return true;
+      }
+
+      mPathToId.erase(it);
+   }
+
+   mStats.misses++;
+   return false;
+}
+
+Image TextureManager::decodeImage(const std::string& path, U32 flags)
+{
+   Image img = ::LoadImage(path.c_str());
+   if (img.data && (flags & LOAD_COLOR_KEY) != 0)
+   {
+      ::ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+      ::ImageColorReplace(&img, PINK_BG, BLANK);
+   }
+   return img;
+}
+
+void TextureManager::workerMain()
+{
+   for (;;)
+   {
+      DecodeJob job;
+
       {
-        mTextureList.freeListPtr(slot);
+         std::unique_lock<std::mutex> lock(mJobMutex);
+         mJobSignal.wait(lock, [this]{ return mStopWorker || !mJobQueue.empty(); });
+         if (mStopWorker)
+         {
+            return;
+         }
+
+         job = mJobQueue.front();
+         mJobQueue.pop_front();
+      }
+
+      if (job.wave)
+      {
+         job.wave->set_value(::LoadWave(job.path.c_str()));
+         continue;
       }
+
+      job.image = decodeImage(job.path, job.flags);
+
+      {
+         std::lock_guard<std::mutex> lock(mJobMutex);
+         mDoneQueue.push_back(job);
+      }
+   }
+}
+
+void TextureManager::processUploads(F64 budgetMs)
+{
+   auto startTime = std::chrono::steady_clock::now();
+
+   for (;;)
+   {
+      DecodeJob job;
+
+      {
+         std::lock_guard<std::mutex> lock(mJobMutex);
+         if (mDoneQueue.empty())
+         {
+            break;
+         }
+
+         job = mDoneQueue.front();
+         mDoneQueue.pop_front();
+      }
+
+      auto itr = mPendingJobs.find(job.id);
+      if (itr != mPendingJobs.end())
+      {
+         TextureSlot* slot = resolveHandle(itr->second);
+         if (slot)
+         {
+            if (job.image.data)
+            {
+               uploadImage(slot, job.image, job.flags);
+            }
+            
+            // Drop the cache entry so a later load can retry; the empty slot
+            // goes once its handles are released
+            if (slot->getWidth() == 0)
+            {
+               Con::errorf("Failed to load image '%s'", job.path.c_str());
+               forgetPath(slot);
+            }
+            slot->mPending = false;
+         }
+
+         mPendingJobs.erase(itr);
+      }
+
+      if (job.image.data)
+      {
+         ::UnloadImage(job.image);
+      }
+
+      mUploadGeneration++;
+
+      // Always do at least one
+      if (std::chrono::duration<F64, std::milli>(std::chrono::steady_clock::now() - startTime).count() >= budgetMs)
+      {
+         break;
+      }
+   }
+}
+
+void TextureManager::stopWorker()
+{
+   if (!mWorker.joinable())
+   {
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mJobMutex);
+      mStopWorker = true;
+   }
+   mJobSignal.notify_all();
+   mWorker.join();
+
+   // Anyone still waiting on a sound gets an empty wave
+   for (DecodeJob& job : mJobQueue)
+   {
+      if (job.wave)
+      {
+         job.wave->set_value(::Wave{});
+      }
+   }
+
+   for (DecodeJob& job : mDoneQueue)
+   {
+      if (job.image.data)
+      {
+         ::UnloadImage(job.image);
+      }
+   }
+
+   mJobQueue.clear();
+   mDoneQueue.clear();
+   mPendingJobs.clear();
+}
+
+void TextureManager::uploadImage(TextureSlot* slot, const Image& image, U32 flags)
+{
+   if ((flags & LOAD_ATLAS) != 0 && packIntoAtlas(slot, image))
+   {
+      return;
+   }
+
+   ::Texture2D tex = ::LoadTextureFromImage(image);
+   if (tex.id != 0)
+   {
+      slot->mTexture = tex;
+      slot->mSourceRect = RectI(0, 0, tex.width, tex.height);
+      slot->mBytes = ::GetPixelDataSize(tex.width, tex.height, tex.format);
+      mStats.residentBytes += slot->mBytes;
+   }
+}
+
+bool TextureManager::packIntoAtlas(TextureSlot* slot, const Image& image)
+{
+   if (image.width > MaxAtlasImageSize || image.height > MaxAtlasImageSize)
+   {
+      return false;
+   }
+
+   RectI rect;
+   S32 pageIndex = -1;
+
+   S32 freeIndex = -1;
+
+   for (U32 i=0; i<mAtlasPages.size(); i++)
+   {
+      if (!mAtlasPages[i].isLive())
+      {
+         freeIndex = freeIndex < 0 ? (S32)i : freeIndex;
+         continue;
+      }
+      
+      if (mAtlasPages[i].allocRect(image.width, image.height, rect))
+      {
+         pageIndex = i;
+         break;
+      }
+   }
+
+   if (pageIndex < 0)
+   {
+      TextureAtlasPage page = {};
+      page.mImage = ::GenImageColor(TextureAtlasPage::PageSize, TextureAtlasPage::PageSize, BLANK);
+      page.mTexture = ::LoadTextureFromImage(page.mImage);
+      if (page.mTexture.id == 0)
+      {
+         ::UnloadImage(page.mImage);
+         return false;
+      }
+
+      if (freeIndex >= 0)
+      {
+         pageIndex = freeIndex;
+         mAtlasPages[pageIndex] = page;
+      }
+      else
+      {
+         mAtlasPages.push_back(page);
+         pageIndex = mAtlasPages.size() - 1;
+      }
+
+      mStats.residentBytes += TextureAtlasPage::PageBytes;
+      mStats.atlasBytes += TextureAtlasPage::PageBytes;
+
+      if (!mAtlasPages[pageIndex].allocRect(image.width, image.height, rect))
+      {
+         releaseAtlasPage(pageIndex);
+         return false;
+      }
+   }
+
+   TextureAtlasPage& page = mAtlasPages[pageIndex];
+
+   // Copy rows straight in; page is RGBA8
+   Image src = ::ImageCopy(image);
+   ::ImageFormat(&src, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+   const U32 rowBytes = src.width * 4;
+   U8* dstPixels = (U8*)page.mImage.data;
+   const U8* srcPixels = (const U8*)src.data;
+
+   for (S32 y=0; y<src.height; y++)
+   {
+      memcpy(dstPixels + (((rect.point.y + y) * TextureAtlasPage::PageSize) + rect.point.x) * 4,
+             srcPixels + (y * rowBytes),
+             rowBytes);
+   }
+
+   ::UnloadImage(src);
+   page.mDirty = true;
+
+   slot->mTexture = page.mTexture;
+   slot->mAtlasPage = pageIndex;
+   slot->mSourceRect = rect;
+   page.mSlotCount++;
+   return true;
+}
+
+void TextureManager::releaseAtlasPage(S32 pageIndex)
+{
+   TextureAtlasPage& page = mAtlasPages[pageIndex];
+   if (!page.isLive())
+   {
+      return;
+   }
+
+   ::UnloadTexture(page.mTexture);
+   ::UnloadImage(page.mImage);
+   page = {};
+
+   mStats.residentBytes -= getMin((U64)TextureAtlasPage::PageBytes, mStats.residentBytes);
+   mStats.atlasBytes -= getMin((U64)TextureAtlasPage::PageBytes, mStats.atlasBytes);
+}
+
+U32 TextureManager::getAtlasPageCount() const
+{
+   U32 count = 0;
+   for (const TextureAtlasPage& page : mAtlasPages)
+   {
+      count += page.isLive() ? 1 : 0;
+   }
+   return count;
+}
+
+void TextureManager::flushAtlasPages()
+{
+   for (TextureAtlasPage& page : mAtlasPages)
+   {
+      if (page.isLive() && page.mDirty)
+      {
+         ::UpdateTexture(page.mTexture, page.mImage.data);
+         page.mDirty = false;
+      }
+   }
+}
+
+void TextureManager::forgetPath(TextureSlot* slot)
+{
+   auto it = mPathToId.find(slot->mPath);
+   if (it != mPathToId.end() && resolveHandle(TextureHandle(it->second, false)) == slot)
+   {
+      mPathToId.erase(it);
+   }
+}
+
+void TextureManager::freeSlot(TextureSlot* slot)
+{
+   forgetPath(slot);
+
+   const S32 pageIndex = slot->mAtlasPage;
+
+   mStats.residentBytes -= getMin((U64)slot->mBytes, mStats.residentBytes);
+   slot->mBytes = 0;
+   slot->reset();
+   mTextureList.freeListPtr(slot);
+
+   if (pageIndex >= 0 && --mAtlasPages[pageIndex].mSlotCount == 0)
+   {
+      releaseAtlasPage(pageIndex);
+   }
+}
+
+void TextureManager::collectUnused(std::vector<EvictCandidate>& outCandidates, std::vector<TextureSlot*>& outAtlasSlots)
+{
+   // A page can only go once nothing packed into it is referenced
+   std::vector<bool> pageBusy(mAtlasPages.size(), false);
+   std::vector<U32> pageRelease(mAtlasPages.size(), 0);
+
+   mTextureList.forEach([&](TextureSlot* slot){
+      const bool unused = slot->mRefCount == 0 && !slot->mPending;
+      if (slot->mAtlasPage >= 0)
+      {
+         if (unused)
+         {
+            outAtlasSlots.push_back(slot);
+            pageRelease[slot->mAtlasPage] = getMax(pageRelease[slot->mAtlasPage], slot->mLastRelease);
+         }
+         else
+         {
+            pageBusy[slot->mAtlasPage] = true;
+         }
+      }
+      else if (unused)
+      {
+         outCandidates.push_back({slot->mLastRelease, slot, -1});
+      }
+   });
+
+   for (U32 i=0; i<mAtlasPages.size(); i++)
+   {
+      if (mAtlasPages[i].isLive() && !pageBusy[i])
+      {
+         outCandidates.push_back({pageRelease[i], NULL, (S32)i});
+      }
+   }
+}
+
+void TextureManager::evict(const EvictCandidate& candidate, const std::vector<TextureSlot*>& atlasSlots)
+{
+   if (candidate.slot)
+   {
+      freeSlot(candidate.slot);
+      return;
+   }
+
+   // Freeing the last slot releases the page
+   for (TextureSlot* slot : atlasSlots)
+   {
+      if (slot->mAtlasPage == candidate.atlasPage)
+      {
+         freeSlot(slot);
+      }
+   }
+}
+
+void TextureManager::flushUnused()
+{
+   // In-flight decodes stay put; atlas images only go with their whole page
+   std::vector<EvictCandidate> candidates;
+   std::vector<TextureSlot*> atlasSlots;
+   collectUnused(candidates, atlasSlots);
+
+   for (const EvictCandidate& candidate : candidates)
+   {
+      evict(candidate, atlasSlots);
+   }
+}
+
+void TextureManager::enforceBudget()
+{
+   if (mStats.residentBytes <= mStats.budgetBytes)
+   {
+      return;
+   }
+
+   std::vector<EvictCandidate> candidates;
+   std::vector<TextureSlot*> atlasSlots;
+   collectUnused(candidates, atlasSlots);
+
+   std::sort(candidates.begin(), candidates.end(), [](const EvictCandidate& a, const EvictCandidate& b){
+      return a.lastRelease < b.lastRelease;
    });
+
+   for (const EvictCandidate& candidate : candidates)
+   {
+      if (mStats.residentBytes <= mStats.budgetBytes)
+      {
+         break;
+      }
+
+      evict(candidate, atlasSlots);
+      mStats.evictions++;
+   }
 }
 
 void TextureManager::cleanup() 
@@ -69,4 +624,56 @@ void TextureManager::cleanup()
    mTextureList.forEach([this](TextureSlot* slot){
     mTextureList.freeListPtr(slot);
    });
+   
+   for (TextureAtlasPage& page : mAtlasPages)
+   {
+      if (page.isLive())
+      {
+         ::UnloadTexture(page.mTexture);
+         ::UnloadImage(page.mImage);
+      }
+   }
+   mAtlasPages.clear();
+   mPathToId.clear();
+   mStats.residentBytes = 0;
+   mStats.atlasBytes = 0;
+}
+
+
+ConsoleFunctionValue(setTextureBudget, 2, 2, "(megabytes)")
+{
+   gTextureManager->mStats.budgetBytes = (U64)vmPtr->valueAsInt(argv[1]) * 1024 * 1024;
+   gTextureManager->enforceBudget();
+   return KorkApi::ConsoleValue();
+}
+
+ConsoleFunctionValue(getTextureStat, 2, 2, "(name) - resident, budget, atlas, hits, misses, evictions")
+{
+   const TextureManager::Stats& stats = gTextureManager->mStats;
+   const char* name = vmPtr->valueAsString(argv[1]);
+
+   if (strcasecmp(name, "resident") == 0)
+      return KorkApi::ConsoleValue::makeUnsigned((U32)(stats.residentBytes / 1024));
+   else if (strcasecmp(name, "budget") == 0)
+      return KorkApi::ConsoleValue::makeUnsigned((U32)(stats.budgetBytes / 1024));
+   else if (strcasecmp(name, "atlas") == 0)
+      return KorkApi::ConsoleValue::makeUnsigned((U32)(stats.atlasBytes / 1024));
+   else if (strcasecmp(name, "hits") == 0)
+      return KorkApi::ConsoleValue::makeUnsigned(stats.hits);
+   else if (strcasecmp(name, "misses") == 0)
+      return KorkApi::ConsoleValue::makeUnsigned(stats.misses);
+   else if (strcasecmp(name, "evictions") == 0)
+      return KorkApi::ConsoleValue::makeUnsigned(stats.evictions);
+
+   Con::errorf("getTextureStat: unknown stat '%s'", name);
+   return KorkApi::ConsoleValue::makeUnsigned(0);
+}
+
+ConsoleFunctionValue(dumpTextureStats, 1, 1, "")
+{
+   const TextureManager::Stats& stats = gTextureManager->mStats;
+   Con::printf("Textures: %uKB resident of %uKB budget", (U32)(stats.residentBytes / 1024), (U32)(stats.budgetBytes / 1024));
+   Con::printf("  atlas pages %uKB (%u pages)", (U32)(stats.atlasBytes / 1024), (U32)gTextureManager->getAtlasPageCount());
+   Con::printf("  hits %u misses %u evictions %u", stats.hits, stats.misses, stats.evictions);
+   return KorkApi::ConsoleValue();
 }
@@ -24,10 +24,25 @@ public:
    U8 mGeneration : 7;
    S32 mRefCount;
 
-   ::Texture2D mTexture;
+   ::Texture2D mTexture;    // NOTE: shared page texture if mAtlasPage >= 0
    std::string mPath;
+   S32 mAtlasPage;
+   RectI mSourceRect;       // area of mTexture holding this image
+   bool mPending;           // still being decoded; size is 0 until uploaded
+   U32 mBytes;              // GPU memory owned by this slot (0 for atlas images)
+   U32 mLastRelease;        // when mRefCount last hit 0, for LRU eviction
+
+   static U32 smReleaseCounter;
+
+   TextureSlot() : mAllocNumber(0), mGeneration(0), mTexture({}), mRefCount(0), mAtlasPage(-1), mSourceRect(0,0,0,0), mPending(false), mBytes(0), mLastRelease(0) {;}
 
-   TextureSlot() : mAllocNumber(0), mGeneration(0), mTexture({}), mRefCount(0) {;}
+    inline S32 getWidth() const { return mSourceRect.extent.x; }
+    inline S32 getHeight() const { return mSourceRect.extent.y; }
+
+    inline ::Rectangle getSourceRect() const
+    {
+        return (::Rectangle){ (float)mSourceRect.point.x, (float)mSourceRect.point.y, (float)mSourceRect.extent.x, (float)mSourceRect.extent.y };
+    }
 
 
     void incRef()
@@ -37,15 +52,20 @@ public:
 
     void decRef()
     {
-        if (mRefCount > 0) mRefCount--;
+        if (mRefCount > 0 && --mRefCount == 0)
+        {
+            mLastRelease = ++smReleaseCounter;
+        }
     }
 
     void reset()
     {
-        if (mTexture.id != 0)
+        if (mTexture.id != 0 && mAtlasPage < 0)
         {
             ::UnloadTexture(mTexture);
         }
+        mTexture = {};
+        mAtlasPage = -1;
         mPath = "";
     }
 
@@ -135,25 +155,144 @@ public:
    TextureSlot* getPtr() const;
 };
 
+// Shared texture which small images are shelf packed into. Pixels are staged
+// in a CPU image and uploaded at most once per frame. A page is released
+// once the last slot packed into it is freed; its entry is then reused.
+struct TextureAtlasPage
+{
+   enum
+   {
+      PageSize = 1024,
+      Padding = 1,
+      PageBytes = PageSize * PageSize * 4 * 2 // GPU texture plus CPU staging image
+   };
+
+   ::Image mImage;
+   ::Texture2D mTexture;
+   S32 mShelfX;
+   S32 mShelfY;
+   S32 mShelfHeight;
+   U32 mSlotCount;          // slots packed into this page
+   bool mDirty;
+
+   inline bool isLive() const { return mTexture.id != 0; }
+
+   bool allocRect(S32 width, S32 height, RectI& outRect);
+};
+
 class TextureManager 
 {
 public:
+   enum
+   {
+      MaxAtlasImageSize = 256, // larger images always get their own texture
+      DefaultBudgetMB = 256
+   };
+
+   enum LoadFlags
+   {
+      LOAD_ATLAS = BIT(0),     // pack into an atlas page if small enough
+      LOAD_COLOR_KEY = BIT(1)  // PINK_BG becomes transparent
+   };
+
+   struct Stats
+   {
+      U64 residentBytes; // textures and atlas pages; this is what the budget covers
+      U64 budgetBytes;
+      U64 atlasBytes;    // atlas page share of residentBytes
+      U32 hits;
+      U32 misses;
+      U32 evictions;
+   };
+
+   Stats mStats;
+
     FreeListPtr<TextureSlot, TextureHandle, std::vector> mTextureList;
 
    TextureManager();
    ~TextureManager();
 
-    TextureHandle loadTexture(const std::string& path, Image* existingImage = NULL);
+    TextureHandle loadTexture(const std::string& path, Image* existingImage = NULL, bool useAtlas = false);
+
+    // Returns a pending handle straight away; the file is decoded on the
+    // worker thread and uploaded later by processUploads. key is the name
+    // used to share textures, filePath is what actually gets loaded.
+    TextureHandle loadTextureAsync(const std::string& key, const std::string& filePath, U32 flags);
+
+    // Uploads decoded images until budgetMs has been spent
+    void processUploads(F64 budgetMs);
+
+    // Decodes a sound file on the worker thread, ahead of any queued
+    // images. Without a worker the wave is decoded straight away.
+    std::future<::Wave> loadWaveAsync(const std::string& filePath);
+
+    // Bumped whenever a pending texture finishes loading
+    inline U32 getUploadGeneration() const { return mUploadGeneration; }
+
+    // Uploads any atlas pages modified since the last call
+    void flushAtlasPages();
+    U32 getAtlasPageCount() const;
+
+    void stopWorker();
 
 
     inline TextureSlot* resolveHandle(const TextureHandle& h);
 
     void flushUnused();
 
+    // Frees unreferenced textures, least recently released first, until
+    // resident memory is back under budget. Atlas pages go as a whole once
+    // none of their images are referenced.
+    void enforceBudget();
+
     void cleanup() ;
 
 private:
 
+    struct DecodeJob
+    {
+       U32 id;
+       U32 flags;
+       std::string path;
+       Image image;
+       std::shared_ptr<std::promise<::Wave>> wave; // set for sound jobs
+    };
+
+    // Either a standalone texture or a whole atlas page (slot == NULL)
+    struct EvictCandidate
+    {
+       U32 lastRelease;
+       TextureSlot* slot;
+       S32 atlasPage;
+    };
+
+    bool findLoaded(const std::string& path, TextureHandle& outHandle);
+    void collectUnused(std::vector<EvictCandidate>& outCandidates, std::vector<TextureSlot*>& outAtlasSlots);
+    void evict(const EvictCandidate& candidate, const std::vector<TextureSlot*>& atlasSlots);
+    void forgetPath(TextureSlot* slot);
+    void freeSlot(TextureSlot* slot);
+
+    bool packIntoAtlas(TextureSlot* slot, const Image& image);
+    void releaseAtlasPage(S32 pageIndex);
+    void uploadImage(TextureSlot* slot, const Image& image, U32 flags);
+
+    static Image decodeImage(const std::string& path, U32 flags);
+    void workerMain();
+
+    // Worker queues; guarded by mJobMutex
+    std::thread mWorker;
+    std::mutex mJobMutex;
+    std::condition_variable mJobSignal;
+    std::deque<DecodeJob> mJobQueue;
+    std::deque<DecodeJob> mDoneQueue;
+    bool mStopWorker;
+
+    // Main thread only
+    std::unordered_map<U32, TextureHandle> mPendingJobs;
+    U32 mNextJobId;
+    U32 mUploadGeneration;
+
+    std::vector<TextureAtlasPage> mAtlasPages;
     std::unordered_map<std::string, U32> mPathToId; // path -> slot handle
     std::vector<TextureSlot*> mSlots;                             // id-1 indexing
 };
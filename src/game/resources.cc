@@ -49,12 +49,10 @@ void ImageSet::ensureImageLoaded(U32 n)
    {
       for (U32 i=(U32)mLoadedImages.size(); i<=n; i++)
       {
-         std::string fpath = makeImageFilename(n);
-         char dstName[4096];
-         Con::expandPath(dstName, sizeof(dstName), fpath.c_str(), Con::getCurrentCodeBlockFullPath());
-         if (Platform::isFile(dstName))
+         std::string dstName = expandImageFilename(i);
+         if (Platform::isFile(dstName.c_str()))
          {
-            Image img = ::LoadImage(dstName);
+            Image img = ::LoadImage(dstName.c_str());
             if (img.data)
             {
                if ((mFlags & FLAG_TRANSPARENT) != 0)
@@ -90,6 +88,14 @@ std::string ImageSet::makeImageFilename(U32 n)
     return path;
 }
 
+std::string ImageSet::expandImageFilename(U32 n)
+{
+   std::string fpath = makeImageFilename(n);
+   char dstName[4096];
+   Con::expandPath(dstName, sizeof(dstName), fpath.c_str(), Con::getCurrentCodeBlockFullPath());
+   return dstName;
+}
+
 void ImageSet::initPersistFields()
 {
    Parent::initPersistFields();
@@ -13,7 +13,8 @@ struct BoxInfo
 {
    enum
    {
-      NumScaleSlots = 5
+      NumScaleSlots = 5,
+      GridCellSize = 32 // pixels per spatial index cell
    };
    
    enum BoxFlags
@@ -52,6 +53,43 @@ struct BoxInfo
    std::vector<ScaleInfo> scaleBands;
    std::vector<U8> nextBoxHopList;
    
+   // Cached connection between two boxes; only depends on box geometry
+   struct Portal
+   {
+      Point2I midOnSrc;  // see PortalEdgePair
+      Point2I overlapA;  // overlap of the src and dst edges, if hasSegment
+      Point2I overlapB;
+      bool hasSegment;
+      bool valid;
+   };
+   
+   std::vector<Portal> portals; // boxes.size() * boxes.size(), indexed src * n + dst
+   
+   // Scale by y for each SCAL slot, for boxes which use one
+   struct BoxScale
+   {
+      S8 slot;   // slotScaleTables index, or -1
+      F32 scale; // fixed scale if > 0, else fall back to the default table
+   };
+   
+   std::vector<F32> slotScaleTables[NumScaleSlots];
+   std::vector<F32> defaultScaleTable; // evalBandScale by y
+   std::vector<BoxScale> boxScales;
+   
+   // Uniform grid over the box AABBs. Each cell lists the boxes touching it
+   // in ascending order, so lookups visit boxes in the same order as a full
+   // scan would.
+   std::vector<RectI> boxBounds;
+   std::vector<U32> gridCellStart; // gridWidth * gridHeight + 1 offsets into gridBoxes
+   std::vector<U16> gridBoxes;
+   Point2I gridOrigin;
+   S32 gridWidth;
+   S32 gridHeight;
+   
+   // Box graph from shared edges (and BOXM neighbours, if present)
+   std::vector<U32> adjacencyStart; // boxes.size() + 1 offsets into adjacency
+   std::vector<U16> adjacency;
+   
    static inline bool OnSegment(const Point2I& a, const Point2I& b, const Point2I& p)
    {
       return std::min(a.x, b.x) <= p.x && p.x <= std::max(a.x, b.x) &&
@@ -111,12 +149,177 @@ struct BoxInfo
       return PolygonCentroid(boxPoints, box.numPoints);
    }
    
+   static inline bool IsValidBox(const Box& b, size_t numPoints)
+   {
+      return b.numPoints >= 3 && b.startPoint + b.numPoints <= numPoints;
+   }
+   
+   void buildSpatialIndex()
+   {
+      const U32 nBoxes = boxes.size();
+      boxBounds.clear();
+      boxBounds.resize(nBoxes, RectI(0,0,0,0));
+      gridCellStart.clear();
+      gridBoxes.clear();
+      gridOrigin = Point2I(0,0);
+      gridWidth = 0;
+      gridHeight = 0;
+      
+      Point2I mn(std::numeric_limits<S32>::max(), std::numeric_limits<S32>::max());
+      Point2I mx(std::numeric_limits<S32>::min(), std::numeric_limits<S32>::min());
+      
+      for (U32 i = 0; i < nBoxes; i++)
+      {
+         if (!IsValidBox(boxes[i], points.size()))
+         {
+            continue;
+         }
+         
+         RectI aabb = PolyAABB(&points[boxes[i].startPoint], boxes[i].numPoints);
+         boxBounds[i] = aabb;
+         mn.x = std::min(mn.x, aabb.point.x);
+         mn.y = std::min(mn.y, aabb.point.y);
+         mx.x = std::max(mx.x, aabb.point.x + aabb.extent.x);
+         mx.y = std::max(mx.y, aabb.point.y + aabb.extent.y);
+      }
+      
+      if (mn.x > mx.x)
+      {
+         gridCellStart.push_back(0);
+         return;
+      }
+      
+      gridOrigin = mn;
+      gridWidth = ((mx.x - mn.x) / GridCellSize) + 1;
+      gridHeight = ((mx.y - mn.y) / GridCellSize) + 1;
+      
+      // Count, then fill; ascending box order is kept within each cell
+      const U32 nCells = gridWidth * gridHeight;
+      gridCellStart.resize(nCells + 1, 0);
+      
+      for (U32 pass = 0; pass < 2; pass++)
+      {
+         std::vector<U32> cursor;
+         if (pass == 1)
+         {
+            for (U32 c = 0; c < nCells; c++)
+            {
+               gridCellStart[c+1] += gridCellStart[c];
+            }
+            gridBoxes.resize(gridCellStart[nCells]);
+            cursor.assign(gridCellStart.begin(), gridCellStart.end() - 1);
+         }
+         
+         for (U32 i = 0; i < nBoxes; i++)
+         {
+            if (!IsValidBox(boxes[i], points.size()))
+            {
+               continue;
+            }
+            
+            const RectI& aabb = boxBounds[i];
+            const S32 cx0 = (aabb.point.x - gridOrigin.x) / GridCellSize;
+            const S32 cy0 = (aabb.point.y - gridOrigin.y) / GridCellSize;
+            const S32 cx1 = (aabb.point.x + aabb.extent.x - gridOrigin.x) / GridCellSize;
+            const S32 cy1 = (aabb.point.y + aabb.extent.y - gridOrigin.y) / GridCellSize;
+            
+            for (S32 cy = cy0; cy <= cy1; cy++)
+            {
+               for (S32 cx = cx0; cx <= cx1; cx++)
+               {
+                  const U32 cell = cy * gridWidth + cx;
+                  if (pass == 0)
+                     gridCellStart[cell+1]++;
+                  else
+                     gridBoxes[cursor[cell]++] = (U16)i;
+               }
+            }
+         }
+      }
+   }
+   
+   inline void ensureSpatialIndex()
+   {
+      if (gridCellStart.empty() || boxBounds.size() != boxes.size())
+      {
+         buildSpatialIndex();
+      }
+   }
+   
+   // Range of gridBoxes which might contain p
+   bool getGridCell(Point2I p, U32& outStart, U32& outEnd)
+   {
+      ensureSpatialIndex();
+      
+      if (p.x < gridOrigin.x || p.y < gridOrigin.y)
+      {
+         return false;
+      }
+      
+      const S32 cx = (p.x - gridOrigin.x) / GridCellSize;
+      const S32 cy = (p.y - gridOrigin.y) / GridCellSize;
+      if (cx >= gridWidth || cy >= gridHeight)
+      {
+         return false;
+      }
+      
+      const U32 cell = cy * gridWidth + cx;
+      outStart = gridCellStart[cell];
+      outEnd = gridCellStart[cell+1];
+      return outStart != outEnd;
+   }
+   
+   static inline S32 AABBDist2(const RectI& rect, Point2I p)
+   {
+      const S32 dx = std::max(std::max(rect.point.x - p.x, 0), p.x - (rect.point.x + rect.extent.x));
+      const S32 dy = std::max(std::max(rect.point.y - p.y, 0), p.y - (rect.point.y + rect.extent.y));
+      return dx*dx + dy*dy;
+   }
+   
    bool FindContainingBox(Point2I dst,
                           bool (*isSelectable)(const Box&),
                           bool preferHigherIndex,
                           S32 threshold,
                           AdjustBoxResult& outResult
                           ) {
+      // Without a threshold only boxes whose AABB holds dst can match, and
+      // those are all in dst's grid cell
+      if (threshold <= 0)
+      {
+         U32 cellStart = 0;
+         U32 cellEnd = 0;
+         if (!getGridCell(dst, cellStart, cellEnd))
+         {
+            return false;
+         }
+         
+         const S32 count = cellEnd - cellStart;
+         for (S32 k = 0; k < count; k++)
+         {
+            const S32 i = gridBoxes[preferHigherIndex ? (cellEnd - 1 - k) : (cellStart + k)];
+            const Box& b = boxes[i];
+            
+            if (!isSelectable(b) ||
+                AABBQuickReject(boxBounds[i], dst, 0))
+            {
+               continue;
+            }
+            
+            if (PointInConvexPoly(&points[b.startPoint], b.numPoints, dst))
+            {
+               outResult.pos = dst;
+               outResult.box = i;
+               outResult.inside = true;
+               outResult.bestD2 = 0;
+               return true;
+            }
+         }
+         
+         return false;
+      }
+      
+      ensureSpatialIndex();
+      
       const S32 nBoxes = U32(boxes.size());
       const S32 begin = preferHigherIndex ? (nBoxes - 1) : 0;
       const S32 end   = preferHigherIndex ? -1 : nBoxes;
@@ -136,13 +339,9 @@ struct BoxInfo
          const Point2I* poly = &points[b.startPoint];
          const U32 n = b.numPoints;
          
-         if (threshold > 0)
+         if (AABBQuickReject(boxBounds[i], dst, threshold))
          {
-            RectI aabb = PolyAABB(poly, n);
-            if (AABBQuickReject(aabb, dst, threshold))
-            {
-               continue;
-            }
+            continue;
          }
          
          if (PointInConvexPoly((Point2I*)poly, n, dst))
@@ -158,6 +357,83 @@ struct BoxInfo
       return false;
    }
    
+   inline bool BoxContainsPoint(S32 i, Point2I p, bool (*isSelectable)(const Box&))
+   {
+      const Box& b = boxes[i];
+      return isSelectable(b) &&
+             IsValidBox(b, points.size()) &&
+             !AABBQuickReject(boxBounds[i], p, 0) &&
+             PointInConvexPoly(&points[b.startPoint], b.numPoints, p);
+   }
+   
+   // FindContainingBox (no threshold) for something last seen in lastBox.
+   // lastBox and then its neighbours are tried before the full search; the
+   // box returned is the same one FindContainingBox would give.
+   bool TrackContainingBox(Point2I dst,
+                           S32 lastBox,
+                           bool (*isSelectable)(const Box&),
+                           bool preferHigherIndex,
+                           AdjustBoxResult& outResult
+                           ) {
+      ensureSpatialIndex();
+      ensureAdjacency();
+      
+      S32 found = -1;
+      if (lastBox >= 0 && lastBox < (S32)boxes.size())
+      {
+         if (BoxContainsPoint(lastBox, dst, isSelectable))
+         {
+            found = lastBox;
+         }
+         else
+         {
+            for (U32 k = adjacencyStart[lastBox]; k < adjacencyStart[lastBox+1]; k++)
+            {
+               if (BoxContainsPoint(adjacency[k], dst, isSelectable))
+               {
+                  found = adjacency[k];
+                  break;
+               }
+            }
+         }
+      }
+      
+      if (found < 0)
+      {
+         return FindContainingBox(dst, isSelectable, preferHigherIndex, 0, outResult);
+      }
+      
+      // Where boxes overlap the full search takes the first match in index
+      // order, so check the ones it would have tried before ours. Cells are
+      // sorted, and mostly fail on the AABB.
+      U32 cellStart = 0;
+      U32 cellEnd = 0;
+      if (getGridCell(dst, cellStart, cellEnd))
+      {
+         const S32 count = cellEnd - cellStart;
+         for (S32 k = 0; k < count; k++)
+         {
+            const S32 i = gridBoxes[preferHigherIndex ? (cellEnd - 1 - k) : (cellStart + k)];
+            if (preferHigherIndex ? (i <= found) : (i >= found))
+            {
+               break;
+            }
+            
+            if (BoxContainsPoint(i, dst, isSelectable))
+            {
+               found = i;
+               break;
+            }
+         }
+      }
+      
+      outResult.pos = dst;
+      outResult.box = found;
+      outResult.inside = true;
+      outResult.bestD2 = 0;
+      return true;
+   }
+   
    bool FindNearestBoxAndSnapPoint(Point2I dst,
                                    bool (*isSelectable)(const Box&),
                                    bool preferHigherIndex,
@@ -169,6 +445,8 @@ struct BoxInfo
       Point2I bestPt = dst;
       S32 bestD2 = std::numeric_limits<S32>::max();
       
+      ensureSpatialIndex();
+      
       const S32 nBoxes = S32(boxes.size());
       const S32 begin = preferHigherIndex ? (nBoxes - 1) : 0;
       const S32 end   = preferHigherIndex ? -1 : nBoxes;
@@ -187,13 +465,17 @@ struct BoxInfo
          const Point2I* poly = &points[b.startPoint];
          const U32 n = b.numPoints;
          
-         if (threshold > 0)
+         if (threshold > 0 &&
+             AABBQuickReject(boxBounds[i], dst, threshold))
          {
-            RectI aabb = PolyAABB(poly, n);
-            if (AABBQuickReject(aabb, dst, threshold))
-            {
-               continue;
-            }
+            continue;
+         }
+         
+         // The closest edge point lies inside the AABB, so this box can't
+         // beat what we already have
+         if (AABBDist2(boxBounds[i], dst) >= bestD2)
+         {
+            continue;
          }
          
          Point2I q = ClosestPointOnConvexPolyEdges(poly, n, dst);
@@ -265,6 +547,11 @@ struct BoxInfo
    
    static inline Point2I ClosestPointOnConvexPolyEdges(const Point2I* poly, U32 n, Point2I p)
    {
+      if (n == 4)
+      {
+         return BoxKernels::QuadClosestEdgePoint(poly, p);
+      }
+      
       Point2I best = poly[0];
       S32 bestD2 = std::numeric_limits<S32>::max();
       
@@ -290,6 +577,11 @@ struct BoxInfo
          return false;
       }
       
+      if (n == 4)
+      {
+         return BoxKernels::QuadContainsPoint(poly, p);
+      }
+      
       if (PointOnEdge(poly, n, p))
       {
          return true;
@@ -311,18 +603,130 @@ struct BoxInfo
    
    F32 evalScale(Point2I roomPos)
    {
-      F32 outScale = 1.0f;
-      U16 realRoomPos = std::clamp(roomPos.x, 0, 65536);
-      evalBandScale(realRoomPos, outScale);
+      F32 outScale = evalBandScale(std::clamp(roomPos.y, 0, 65535));
       evalBoxScale(roomPos, outScale); // may override
       return outScale;
    }
    
+   // Table lookup equivalent of evalScale for a point already known to be
+   // in box (or in no box if box < 0)
+   F32 getScaleAt(S32 box, Point2I roomPos)
+   {
+      ensureScaleTables();
+      
+      const S32 yIdx = std::clamp(roomPos.y, 0, (S32)defaultScaleTable.size() - 1);
+      if (box > 0 && box < (S32)boxScales.size())
+      {
+         // evalScale skips disabled boxes and may find another one under
+         // the point, so take the slow path for those
+         if (boxes[box].flags & BOXF_DISABLED)
+         {
+            return evalScale(roomPos);
+         }
+         
+         const BoxScale& info = boxScales[box];
+         if (info.slot >= 0)
+         {
+            return slotScaleTables[info.slot][yIdx];
+         }
+         else if (info.scale > 0.0f)
+         {
+            return info.scale;
+         }
+      }
+      
+      return defaultScaleTable[yIdx];
+   }
+   
+   void buildScaleTables()
+   {
+      // Cover every y a point or band refers to
+      S32 maxY = 0;
+      for (const Point2I& pt : points)
+      {
+         maxY = std::max(maxY, pt.y);
+      }
+      for (const ScaleInfo& info : scaleBands)
+      {
+         maxY = std::max(maxY, (S32)std::max(info.sy1[1], info.sy2[1]));
+      }
+      
+      const U32 tableSize = maxY + 1;
+      defaultScaleTable.resize(tableSize);
+      for (U32 i = 0; i < NumScaleSlots; i++)
+      {
+         slotScaleTables[i].assign(tableSize, 1.0f);
+      }
+      
+      for (U32 y = 0; y < tableSize; y++)
+      {
+         defaultScaleTable[y] = evalBandScale(y);
+         for (U32 i = 0; i < scaleBands.size() && i < NumScaleSlots; i++)
+         {
+            slotScaleTables[i][y] = evalScaleForBand(scaleBands[i], y);
+         }
+      }
+      
+      boxScales.resize(boxes.size());
+      for (U32 i = 0; i < boxes.size(); i++)
+      {
+         updateBoxScale(i);
+      }
+   }
+   
+   // Refreshes one boxScales entry, e.g. after its flags change
+   void updateBoxScale(U32 i)
+   {
+      if (i >= boxScales.size())
+      {
+         return;
+      }
+      
+      const Box& box = boxes[i];
+      BoxScale& info = boxScales[i];
+      info.slot = -1;
+      info.scale = 0.0f;
+      
+      if (box.flags & BOXF_IGNORE_SCALE)
+      {
+         info.scale = 1.0f;
+      }
+      else if ((box.scale & 0x8000) != 0)
+      {
+         U16 slot = box.scale & 0x7;
+         if (slot < scaleBands.size())
+         {
+            info.slot = slot;
+         }
+      }
+      else if (box.scale > 0)
+      {
+         info.scale = scaleToFloat(box.scale);
+      }
+   }
+   
+   inline void ensureScaleTables()
+   {
+      if (defaultScaleTable.empty() || boxScales.size() != boxes.size())
+      {
+         buildScaleTables();
+      }
+   }
+   
    void evalBoxScale(Point2I roomPos, F32& outScale)
    {
-      for (Box& box : boxes)
+      U32 cellStart = 0;
+      U32 cellEnd = 0;
+      if (!getGridCell(roomPos, cellStart, cellEnd))
+      {
+         return;
+      }
+      
+      for (U32 k = cellStart; k < cellEnd; k++)
       {
-         if (PointInConvexPoly(points.data() + box.startPoint, box.numPoints, roomPos))
+         Box& box = boxes[gridBoxes[k]];
+         if (!AABBQuickReject(boxBounds[gridBoxes[k]], roomPos, 0) &&
+             PointInConvexPoly(points.data() + box.startPoint, box.numPoints, roomPos))
          {
             if (box.flags & BOXF_DISABLED)
             {
@@ -336,8 +740,10 @@ struct BoxInfo
             else if ((box.scale & 0x8000) != 0)
             {
                U16 trueScale = box.scale & 0x7;
-               U16 realRoomPos = std::clamp(roomPos.x, 0, 65536);
-               outScale = evalScaleForBand(scaleBands[trueScale], realRoomPos);
+               if (trueScale < scaleBands.size())
+               {
+                  outScale = evalScaleForBand(scaleBands[trueScale], std::clamp(roomPos.y, 0, 65535));
+               }
             }
             else if (box.scale > 0)
             {
@@ -349,19 +755,23 @@ struct BoxInfo
       }
    }
    
-   inline F32 evalScaleForBand(ScaleInfo& info, S16 roomPos)
+   inline F32 evalScaleForBand(const ScaleInfo& info, S32 roomPos)
    {
       F32 startScale = scaleToFloat(info.sy1[0]);
       F32 endScale = scaleToFloat(info.sy2[0]);
       
-      U16 relPos = roomPos - info.sy1[1];
-      U16 bandSize = info.sy2[1] - info.sy1[1];
+      S32 relPos = roomPos - (S32)info.sy1[1];
+      S32 bandSize = (S32)info.sy2[1] - (S32)info.sy1[1];
+      if (bandSize == 0)
+      {
+         return startScale;
+      }
       
-      F32 ratioInBand = (F32)(relPos) / (F32) bandSize;
+      F32 ratioInBand = std::clamp((F32)(relPos) / (F32) bandSize, 0.0f, 1.0f);
       return startScale + (ratioInBand * (endScale - startScale));
    }
    
-   F32 evalBandScale(U16 roomPos, F32 outScale)
+   F32 evalBandScale(S32 roomPos)
    {
       if (scaleBands.empty())
       {
@@ -596,18 +1006,471 @@ struct BoxInfo
    }
    
    
+   Portal ComputePortal(int srcBoxId, int dstBoxId)
+   {
+      Portal portal = {};
+      PortalEdgePair pe = FindBestPortalEdgePair(srcBoxId, dstBoxId);
+      portal.midOnSrc = pe.midOnSrc;
+      portal.hasSegment = ComputeOverlapSegment(pe.srcEdge.a, pe.srcEdge.b,
+                                                pe.dstEdge.a, pe.dstEdge.b,
+                                                portal.overlapA, portal.overlapB);
+      portal.valid = true;
+      return portal;
+   }
+   
+   // Fills in portals for every pair the hop matrix can route between
+   void buildPortalTable()
+   {
+      const U32 n = boxes.size();
+      portals.clear();
+      portals.resize((size_t)n * n);
+      
+      if (nextBoxHopList.size() != (size_t)n * n)
+      {
+         return;
+      }
+      
+      for (U32 src = 1; src < n; src++)
+      {
+         for (U32 dst = 1; dst < n; dst++)
+         {
+            U32 hop = nextBoxHopList[(size_t)src * n + dst];
+            if (hop == src || hop >= n)
+            {
+               continue;
+            }
+            
+            Portal& portal = portals[(size_t)src * n + hop];
+            if (!portal.valid)
+            {
+               portal = ComputePortal(src, hop);
+            }
+         }
+      }
+   }
+   
+   // Table lookup; anything the table missed is computed and kept
+   const Portal& getPortal(int srcBoxId, int dstBoxId)
+   {
+      const size_t n = boxes.size();
+      if (portals.size() != n * n)
+      {
+         portals.clear();
+         portals.resize(n * n);
+      }
+      
+      Portal& portal = portals[(size_t)srcBoxId * n + dstBoxId];
+      if (!portal.valid)
+      {
+         portal = ComputePortal(srcBoxId, dstBoxId);
+      }
+      return portal;
+   }
+   
+   static bool IsWalkableBox(const Box& b)
+   {
+      return (b.flags & (BOXF_DISABLED | BOXF_LOCKED)) == 0;
+   }
+   
+   // True if a and b have a pair of near-parallel edges touching along
+   // some length
+   bool BoxesShareEdge(int a, int b)
+   {
+      const Box& s = boxes[a];
+      const Box& d = boxes[b];
+      if (!IsValidBox(s, points.size()) || !IsValidBox(d, points.size()))
+      {
+         return false;
+      }
+      
+      const RectI& sb = boxBounds[a];
+      const RectI& db = boxBounds[b];
+      if (sb.point.x > db.point.x + db.extent.x + 1 || db.point.x > sb.point.x + sb.extent.x + 1 ||
+          sb.point.y > db.point.y + db.extent.y + 1 || db.point.y > sb.point.y + sb.extent.y + 1)
+      {
+         return false;
+      }
+      
+      const Point2I* ps = &points[s.startPoint];
+      const Point2I* pd = &points[d.startPoint];
+      
+      for (U32 i = 0; i < s.numPoints; ++i)
+      {
+         Point2I s0 = ps[i];
+         Point2I s1 = ps[(i + 1) % s.numPoints];
+         Point2F su = UnitDir(s0, s1);
+         
+         for (U32 j = 0; j < d.numPoints; ++j)
+         {
+            Point2I d0 = pd[j];
+            Point2I d1 = pd[(j + 1) % d.numPoints];
+            
+            if (std::fabs(mDot(su, UnitDir(d0, d1))) < 0.92f ||
+                ApproxSegSegDist2(s0, s1, d0, d1) > 2)
+            {
+               continue;
+            }
+            
+            Point2I oA, oB;
+            if (ComputeOverlapSegment(s0, s1, d0, d1, oA, oB) && oA != oB)
+            {
+               return true;
+            }
+         }
+      }
+      
+      return false;
+   }
+   
+   void buildAdjacency()
+   {
+      ensureSpatialIndex();
+      
+      const U32 n = boxes.size();
+      const bool hasHops = nextBoxHopList.size() == (size_t)n * n;
+      std::vector<std::vector<U16>> lists(n);
+      
+      // Filled in ascending order for both ends, so each list ends up sorted
+      for (U32 a = 1; a < n; a++)
+      {
+         for (U32 b = a + 1; b < n; b++)
+         {
+            bool linked = BoxesShareEdge(a, b);
+            if (!linked && hasHops)
+            {
+               linked = nextBoxHopList[(size_t)a * n + b] == b ||
+                        nextBoxHopList[(size_t)b * n + a] == a;
+            }
+            
+            if (linked)
+            {
+               lists[a].push_back((U16)b);
+               lists[b].push_back((U16)a);
+            }
+         }
+      }
+      
+      adjacencyStart.clear();
+      adjacency.clear();
+      adjacencyStart.reserve(n + 1);
+      for (U32 a = 0; a < n; a++)
+      {
+         adjacencyStart.push_back(adjacency.size());
+         adjacency.insert(adjacency.end(), lists[a].begin(), lists[a].end());
+      }
+      adjacencyStart.push_back(adjacency.size());
+   }
+   
+   inline void ensureAdjacency()
+   {
+      if (adjacencyStart.size() != boxes.size() + 1)
+      {
+         buildAdjacency();
+      }
+   }
+   
+   // Regenerates nextBoxHopList from the box graph for rooms without a BOXM
+   // block. Entries are U8, so rooms with more than 255 boxes rely on
+   // FindPath alone.
+   void buildHopList()
+   {
+      ensureAdjacency();
+      
+      const U32 n = boxes.size();
+      nextBoxHopList.clear();
+      if (n == 0 || n > 255)
+      {
+         return;
+      }
+      
+      nextBoxHopList.resize((size_t)n * n, 255);
+      std::vector<U8> firstHop(n);
+      std::deque<U16> queue;
+      
+      for (U32 src = 1; src < n; src++)
+      {
+         std::fill(firstHop.begin(), firstHop.end(), 255);
+         firstHop[src] = (U8)src;
+         queue.clear();
+         queue.push_back((U16)src);
+         
+         while (!queue.empty())
+         {
+            U16 cur = queue.front();
+            queue.pop_front();
+            
+            for (U32 k = adjacencyStart[cur]; k < adjacencyStart[cur+1]; k++)
+            {
+               U16 next = adjacency[k];
+               if (firstHop[next] != 255)
+               {
+                  continue;
+               }
+               
+               firstHop[next] = cur == src ? (U8)next : firstHop[cur];
+               queue.push_back(next);
+            }
+         }
+         
+         memcpy(&nextBoxHopList[(size_t)src * n], firstHop.data(), n);
+      }
+   }
+   
+   static inline F32 TriArea2(const Point2I& a, const Point2I& b, const Point2I& c)
+   {
+      const F32 ax = F32(b.x - a.x), ay = F32(b.y - a.y);
+      const F32 bx = F32(c.x - a.x), by = F32(c.y - a.y);
+      return bx * ay - ax * by;
+   }
+   
+   // Simple stupid funnel over a list of portals. lefts/rights include the
+   // start and end points as zero width portals.
+   static void StringPull(const std::vector<Point2I>& lefts,
+                          const std::vector<Point2I>& rights,
+                          std::vector<Point2I>& outPoints)
+   {
+      Point2I apex = lefts[0];
+      Point2I portalLeft = lefts[0];
+      Point2I portalRight = rights[0];
+      S32 apexIndex = 0;
+      S32 leftIndex = 0;
+      S32 rightIndex = 0;
+      
+      for (S32 i = 1; i < (S32)lefts.size(); i++)
+      {
+         const Point2I& left = lefts[i];
+         const Point2I& right = rights[i];
+         
+         // Tighten the right side
+         if (TriArea2(apex, portalRight, right) <= 0.0f)
+         {
+            if (apex == portalRight || TriArea2(apex, portalLeft, right) > 0.0f)
+            {
+               portalRight = right;
+               rightIndex = i;
+            }
+            else
+            {
+               // Right crossed over left, so left is a corner
+               outPoints.push_back(portalLeft);
+               apex = portalLeft;
+               apexIndex = leftIndex;
+               portalLeft = portalRight = apex;
+               leftIndex = rightIndex = apexIndex;
+               i = apexIndex;
+               continue;
+            }
+         }
+         
+         // Tighten the left side
+         if (TriArea2(apex, portalLeft, left) >= 0.0f)
+         {
+            if (apex == portalLeft || TriArea2(apex, portalRight, left) < 0.0f)
+            {
+               portalLeft = left;
+               leftIndex = i;
+            }
+            else
+            {
+               outPoints.push_back(portalRight);
+               apex = portalRight;
+               apexIndex = rightIndex;
+               portalLeft = portalRight = apex;
+               leftIndex = rightIndex = apexIndex;
+               i = apexIndex;
+               continue;
+            }
+         }
+      }
+      
+      const Point2I& end = lefts.back();
+      if (outPoints.empty() || outPoints.back() != end)
+      {
+         outPoints.push_back(end);
+      }
+   }
+   
+   // A* from srcBox to dstBox through boxes accepted by isSelectable, costed
+   // from the srcBox centre through portal midpoints to the dstBox centre.
+   // The route only depends on the two boxes, so it can be cached by them.
+   // Fills outBoxes with the boxes the path goes through.
+   bool FindBoxPath(int srcBox, int dstBox,
+                    bool (*isSelectable)(const Box&),
+                    std::vector<U16>& outBoxes)
+   {
+      outBoxes.clear();
+      
+      const S32 n = boxes.size();
+      if (srcBox <= 0 || dstBox <= 0 || srcBox >= n || dstBox >= n)
+      {
+         return false;
+      }
+      
+      if (srcBox == dstBox)
+      {
+         outBoxes.push_back((U16)srcBox);
+         return true;
+      }
+      
+      if (!isSelectable(boxes[dstBox]))
+      {
+         return false;
+      }
+      
+      ensureAdjacency();
+      
+      auto dist = [](Point2I a, Point2I b) {
+         return std::sqrt(F32((b - a).lenSquared()));
+      };
+      
+      std::vector<F32> cost(n, std::numeric_limits<F32>::max());
+      std::vector<S16> cameFrom(n, -1);
+      std::vector<Point2I> entry(n);
+      std::vector<U8> closed(n, 0);
+      
+      typedef std::pair<F32, U16> OpenEntry;
+      std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> open;
+      
+      const Point2I goal = GetBoxCenter(dstBox);
+      
+      cost[srcBox] = 0.0f;
+      entry[srcBox] = GetBoxCenter(srcBox);
+      open.push(OpenEntry(dist(entry[srcBox], goal), (U16)srcBox));
+      
+      while (!open.empty())
+      {
+         U16 cur = open.top().second;
+         open.pop();
+         
+         if (closed[cur])
+         {
+            continue;
+         }
+         closed[cur] = 1;
+         
+         if (cur == dstBox)
+         {
+            break;
+         }
+         
+         for (U32 k = adjacencyStart[cur]; k < adjacencyStart[cur+1]; k++)
+         {
+            U16 next = adjacency[k];
+            if (closed[next] || !isSelectable(boxes[next]))
+            {
+               continue;
+            }
+            
+            const Portal& portal = getPortal(cur, next);
+            Point2I mid = portal.hasSegment ? Point2I((portal.overlapA.x + portal.overlapB.x) / 2,
+                                                      (portal.overlapA.y + portal.overlapB.y) / 2) : portal.midOnSrc;
+            
+            // Entering dstBox also pays for the walk to its centre, so the
+            // straight line heuristic never overestimates
+            F32 g = cost[cur] + dist(entry[cur], mid);
+            F32 h = dist(mid, goal);
+            if (next == dstBox)
+            {
+               g += h;
+               h = 0.0f;
+            }
+            
+            if (g < cost[next])
+            {
+               cost[next] = g;
+               cameFrom[next] = cur;
+               entry[next] = mid;
+               open.push(OpenEntry(g + h, next));
+            }
+         }
+      }
+      
+      if (cameFrom[dstBox] < 0)
+      {
+         return false;
+      }
+      
+      for (S32 b = dstBox; b != srcBox; b = cameFrom[b])
+      {
+         outBoxes.push_back((U16)b);
+      }
+      outBoxes.push_back((U16)srcBox);
+      std::reverse(outBoxes.begin(), outBoxes.end());
+      return true;
+   }
+   
+   // String-pulls a box path from FindBoxPath into waypoints, not including
+   // start and ending at end
+   void BuildWaypoints(const std::vector<U16>& path, Point2I start, Point2I end,
+                       std::vector<Point2I>& outWaypoints)
+   {
+      outWaypoints.clear();
+      
+      // Orient each portal consistently relative to the box it leaves
+      std::vector<Point2I> lefts;
+      std::vector<Point2I> rights;
+      lefts.reserve(path.size() + 1);
+      rights.reserve(path.size() + 1);
+      lefts.push_back(start);
+      rights.push_back(start);
+      
+      for (size_t i = 0; i + 1 < path.size(); i++)
+      {
+         const Portal& portal = getPortal(path[i], path[i+1]);
+         Point2I a = portal.hasSegment ? portal.overlapA : portal.midOnSrc;
+         Point2I b = portal.hasSegment ? portal.overlapB : portal.midOnSrc;
+         
+         if (TriArea2(GetBoxCenter(path[i]), a, b) < 0.0f)
+         {
+            rights.push_back(a);
+            lefts.push_back(b);
+         }
+         else
+         {
+            rights.push_back(b);
+            lefts.push_back(a);
+         }
+      }
+      
+      lefts.push_back(end);
+      rights.push_back(end);
+      
+      StringPull(lefts, rights, outWaypoints);
+   }
+   
+   bool FindPath(int srcBox, int dstBox, Point2I start, Point2I end,
+                 bool (*isSelectable)(const Box&),
+                 std::vector<Point2I>& outWaypoints,
+                 std::vector<U16>& outBoxes)
+   {
+      outWaypoints.clear();
+      if (!FindBoxPath(srcBox, dstBox, isSelectable, outBoxes))
+      {
+         return false;
+      }
+      
+      BuildWaypoints(outBoxes, start, end, outWaypoints);
+      return true;
+   }
+   
    U8 getNextBoxIndex(int src, int dst)
    {
       if (src < 0)
       {
          return dst < 0 ? 0 : dst;
       }
+      
+      if (nextBoxHopList.size() != boxes.size() * boxes.size())
+      {
+         return 255;
+      }
       return nextBoxHopList[src * boxes.size() + dst];
    }
    
+   // SCUMM scales are 0-255 with 255 being full size
    static F32 scaleToFloat(uint16_t value)
    {
-      return value / 100.0f;
+      return value / 255.0f;
    }
    
    void reset()
@@ -616,13 +1479,39 @@ struct BoxInfo
       points.clear();
       scaleBands.clear();
       nextBoxHopList.clear();
+      portals.clear();
+      boxBounds.clear();
+      gridCellStart.clear();
+      gridBoxes.clear();
+      adjacencyStart.clear();
+      adjacency.clear();
+      defaultScaleTable.clear();
+      boxScales.clear();
+   }
+   
+   // Baked walk maps, see walkMap.h
+   bool writeBaked(const char* path, U64 sourceHash);
+   bool readBaked(const char* path, U64 sourceHash);
+   static U64 hashSource(const U8* data, U32 size);
+   
+   static std::string getBakedPath(const char* boxFile)
+   {
+      std::string path = boxFile;
+      size_t dot = path.find_last_of('.');
+      if (dot != std::string::npos && path.find('/', dot) == std::string::npos)
+      {
+         path.erase(dot);
+      }
+      return path + ".wmap";
    }
    
    bool read(Stream& stream)
    {
       std::vector<U8> boxmData;
       
-      while (stream.getStatus() == Stream::Ok)
+      // Memory streams don't flag EOS until a read runs past the end
+      while (stream.getStatus() == Stream::Ok &&
+             stream.getPosition() < stream.getStreamSize())
       {
          IFFBlock block;
          if (!stream.read(sizeof(IFFBlock), &block))
@@ -696,7 +1585,8 @@ struct BoxInfo
          {
             scaleBands.clear();
             
-            for (U32 i=0; i<NumScaleSlots; i++)
+            // Slots are 8 bytes each; files don't always have all of them
+            for (U32 i=0; i<NumScaleSlots && size >= 8; i++)
             {
                ScaleInfo info;
                stream.read(&info.sy1[0]);
@@ -704,6 +1594,12 @@ struct BoxInfo
                stream.read(&info.sy2[0]);
                stream.read(&info.sy2[1]);
                scaleBands.push_back(info);
+               size -= 8;
+            }
+            
+            if (size > 0)
+            {
+               stream.setPosition(stream.getPosition() + size);
             }
          }
          else
@@ -761,6 +1657,16 @@ struct BoxInfo
             }
          }
       }
+      
+      buildSpatialIndex();
+      buildScaleTables();
+      buildAdjacency();
+      if (nextBoxHopList.empty())
+      {
+         buildHopList();
+      }
+      buildPortalTable();
+      return true;
    }
 };
 
@@ -796,6 +1702,7 @@ public:
    void ensureImageLoaded(U32 n);
    
    std::string makeImageFilename(U32 n);
+   std::string expandImageFilename(U32 n);
    static void initPersistFields();
    
    DECLARE_CONOBJECT(ImageSet);
@@ -61,6 +61,38 @@ RectI RoomRender::computeWipeRect(int W, int H, float t01, TransitionMode mode,
     return RectI(x,y,w,h);
 }
 
+void RoomRender::markZPlanesDirty(U32 mask, RectI rect)
+{
+   if (!rect.isValidRect())
+   {
+      return;
+   }
+   
+   for (U32 zPlane=0; zPlane<NumZPlanes; zPlane++)
+   {
+      if ((mask & BIT(zPlane)) == 0)
+      {
+         continue;
+      }
+      
+      if (mZPlanesDirty & BIT(zPlane))
+      {
+         mZPlaneDirtyRect[zPlane].unionRects(rect);
+      }
+      else
+      {
+         mZPlaneDirtyRect[zPlane] = rect;
+         mZPlanesDirty |= BIT(zPlane);
+      }
+   }
+}
+
+void RoomRender::markAllZPlanesDirty()
+{
+   // Covers any RT size
+   markZPlanesDirty(BIT(NumZPlanes)-1, RectI(0, 0, 0x7FFF, 0x7FFF));
+}
+
 void RoomRender::updateTransition(float dt)
 {
    transitionPos += dt * (1.0/currentTransition.time);
@@ -107,7 +139,16 @@ Room::Room()
    mTransFlags = 0;
    mNSLinkMask = LinkClassName;
    mRenderState.transitionEnded = false;
+   mRenderState.mZPlanesDirty = 0;
+   mRenderState.mTexturesPending = false;
+   mRenderState.mTextureGeneration = 0;
+   mRenderState.markAllZPlanesDirty();
    mStateFlags = 0;
+   mActorAvoidance = false;
+   mBoxEpoch = 0;
+   mPathCacheClock = 0;
+   mPathCacheHits = 0;
+   mPathCacheMisses = 0;
 
    for (U32 i=0; i<RoomRender::NumZPlanes; i++)
    {
@@ -126,11 +167,21 @@ bool Room::onAdd()
       if (mBoxFileName && mBoxFileName[0] != '\0')
       {
          mBoxes.reset();
-         FileStream fs;
-         if (fs.open(mBoxFileName, FileStream::Read))
+         MappedFile source;
+         if (source.open(mBoxFileName))
          {
-            mBoxes.read(fs);
+            // Prefer the baked walk map if there's an up to date one
+            std::string bakedPath = BoxInfo::getBakedPath(mBoxFileName);
+            const U64 sourceHash = BoxInfo::hashSource(source.getData(), source.getSize());
+            if (!mBoxes.readBaked(bakedPath.c_str(), sourceHash))
+            {
+               MemStream boxStream(source.getSize(), (void*)source.getData(), true, false);
+               mBoxes.read(boxStream);
+            }
          }
+         
+         mBoxEpoch++;
+         mPathCache.clear();
       }
       
       return true;
@@ -141,6 +192,11 @@ bool Room::onAdd()
 void Room::onRemove()
 {
    unregisterTickable();
+   
+   if (gGlobals.roomZPlaneOwner == this)
+   {
+      gGlobals.roomZPlaneOwner = nullptr;
+   }
 }
 
 void Room::setTransitionMode(U8 mode, U8 param, F32 time, bool start)
@@ -176,40 +232,185 @@ void Room::updateLayout(const RectI contentRect)
    mRenderState.roomDisplaySize.y = 144;
 }
 
-void Room::updateResources()
+static TextureHandle LoadRoomTexture(const char* path, bool async)
 {
-   mRenderState.backgroundImage = mImageFileName && *mImageFileName ? gTextureManager->loadTexture(mImageFileName) : nullptr;
+   if (!path || !*path)
+   {
+      return nullptr;
+   }
+   
+   return async ? gTextureManager->loadTextureAsync(path, path, 0) : gTextureManager->loadTexture(path);
+}
+
+void Room::updateResources(bool async)
+{
+   mRenderState.backgroundImage = LoadRoomTexture(mImageFileName, async);
    for (uint32_t i=0; i<RoomRender::NumZPlanes; i++)
    {
-      mRenderState.zPlanes[i] = mZPlaneFiles[i] && *mZPlaneFiles[i] ? gTextureManager->loadTexture(mZPlaneFiles[i]) : nullptr;
+      mRenderState.zPlanes[i] = LoadRoomTexture(mZPlaneFiles[i], async);
    }
    
+   mRenderState.mTexturesPending = true;
+   mRenderState.mTextureGeneration = gTextureManager->getUploadGeneration() - 1;
+   checkPendingResources();
+}
+
+// Starts loading everything the room needs to draw so entering it doesn't
+// stall. Textures and sounds are decoded in the background; the box file is
+// already read in onAdd.
+void Room::prefetch()
+{
+   if (mRenderState.backgroundImage.getNum() == 0)
+   {
+      updateResources(true);
+   }
+   
+   for (SimObject* obj : objectList)
+   {
+      RoomObject* roomObj = dynamic_cast<RoomObject*>(obj);
+      if (roomObj)
+      {
+         roomObj->updateResources();
+         continue;
+      }
+      
+      Actor* actor = dynamic_cast<Actor*>(obj);
+      if (actor && actor->mCostume)
+      {
+         for (Sound* sound : actor->mCostume->mState.mSounds)
+         {
+            if (sound)
+            {
+               sound->prefetch();
+            }
+         }
+      }
+   }
+}
+
+// Picks up the background and z planes once the texture manager has them
+void Room::checkPendingResources()
+{
+   if (!mRenderState.mTexturesPending ||
+       mRenderState.mTextureGeneration == gTextureManager->getUploadGeneration())
+   {
+      return;
+   }
+   
+   mRenderState.mTextureGeneration = gTextureManager->getUploadGeneration();
+   
+   bool pending = false;
    TextureSlot* slot = gTextureManager->resolveHandle(mRenderState.backgroundImage);
    if (slot)
    {
-      mRenderState.backgroundSR = RectI(Point2I(0,0), Point2I(slot->mTexture.width, slot->mTexture.height));
+      pending = slot->mPending;
+      mRenderState.backgroundSR = RectI(Point2I(0,0), Point2I(slot->getWidth(), slot->getHeight()));
    }
    
-   mRenderState.mZPlanesDirty = true;
+   for (uint32_t i=0; i<RoomRender::NumZPlanes; i++)
+   {
+      slot = gTextureManager->resolveHandle(mRenderState.zPlanes[i]);
+      if (slot && slot->mPending)
+      {
+         pending = true;
+      }
+   }
+   
+   mRenderState.mTexturesPending = pending;
+   mRenderState.markAllZPlanesDirty();
+}
+
+static inline RectI ZPlaneEntryRect(const RoomRender::ObjectInfo::Entry& e)
+{
+   return RectI(e.offset, e.extent);
+}
+
+static inline bool ZPlaneEntryEqual(const RoomRender::ObjectInfo::Entry& a, const RoomRender::ObjectInfo::Entry& b)
+{
+   return a.slot == b.slot && a.offset == b.offset && a.extent == b.extent;
+}
+
+// Compares the object z planes enumerated this frame against what was last
+// drawn into the RTs, so state changes and added or removed objects only
+// invalidate the area they cover.
+void Room::syncZPlanes()
+{
+   // RTs are shared between rooms
+   if (gGlobals.roomZPlaneOwner != this)
+   {
+      gGlobals.roomZPlaneOwner = this;
+      mRenderState.markAllZPlanesDirty();
+   }
+   
+   for (U32 zPlane=0; zPlane<RoomRender::NumZPlanes; zPlane++)
+   {
+      std::vector<RoomRender::ObjectInfo::Entry>& built = mRenderState.mBuiltZPlanes[zPlane];
+      std::vector<RoomRender::ObjectInfo::Entry>& current = mRenderState.objectInfo.zPlanes[zPlane];
+      
+      const size_t count = std::max(built.size(), current.size());
+      for (size_t i=0; i<count; i++)
+      {
+         const bool haveBuilt = i < built.size();
+         const bool haveCurrent = i < current.size();
+         
+         if (haveBuilt && haveCurrent && ZPlaneEntryEqual(built[i], current[i]))
+         {
+            continue;
+         }
+         
+         if (haveBuilt)
+         {
+            mRenderState.markZPlanesDirty(BIT(zPlane), ZPlaneEntryRect(built[i]));
+         }
+         
+         if (haveCurrent)
+         {
+            mRenderState.markZPlanesDirty(BIT(zPlane), ZPlaneEntryRect(current[i]));
+         }
+      }
+   }
 }
 
 void Room::updateZPlanes()
 {
+   PROFILE_SCOPE("UpdateZPlanes");
+   
    Vector2 origin = { 0.0, 0.0 };
    Camera2D localCamera = MakeDefaultCamera();
+   RectI rtRect(0, 0, gGlobals.roomZPlaneRt.texture.width, gGlobals.roomZPlaneRt.texture.height);
+   
+   // All planes live in one RT, one color channel each
+   BeginTextureMode(gGlobals.roomZPlaneRt);
+   BeginMode2D(localCamera);
 
    for (U32 zPlane=0; zPlane<RoomRender::NumZPlanes; zPlane++)
    {
-      BeginTextureMode(gGlobals.roomZPlaneRt[zPlane]);
-      BeginMode2D(localCamera);
+      if ((mRenderState.mZPlanesDirty & BIT(zPlane)) == 0)
+      {
+         continue;
+      }
+      
+      RectI dirtyRect = mRenderState.mZPlaneDirtyRect[zPlane];
+      mRenderState.mBuiltZPlanes[zPlane] = mRenderState.objectInfo.zPlanes[zPlane];
+      
+      if (!dirtyRect.intersect(rtRect))
+      {
+         continue;
+      }
+      
+      rlDrawRenderBatchActive();
+      rlColorMask(zPlane == 0, zPlane == 1, zPlane == 2, false);
+      BeginScissorMode(dirtyRect.point.x, dirtyRect.point.y, dirtyRect.extent.x, dirtyRect.extent.y);
+      
+      ClearBackground(BLANK);
 
       // Draw room zplane
       {
          TextureSlot* maskSlot = gTextureManager->resolveHandle(mRenderState.zPlanes[zPlane]);
          if (maskSlot)
          {
-            Rectangle src = { 0.0f, 0.0f, (float)maskSlot->mTexture.width, (float)maskSlot->mTexture.height };
-            Rectangle dest = { 0.0f, 0.0f, (float)maskSlot->mTexture.width, (float)maskSlot->mTexture.height };
+            Rectangle src = maskSlot->getSourceRect();
+            Rectangle dest = { 0.0f, 0.0f, (float)maskSlot->getWidth(), (float)maskSlot->getHeight() };
             DrawTexturePro(maskSlot->mTexture, src, dest, origin, 0.0f, WHITE);
          }
                
@@ -223,16 +424,21 @@ void Room::updateZPlanes()
          {
             if (e.slot)
             {
-               Rectangle src = { 0.0f, 0.0f, (float)e.slot->mTexture.width, (float)e.slot->mTexture.height };
-               Rectangle dest = { (float)e.offset.x, (float)e.offset.y, (float)e.slot->mTexture.width, (float)e.slot->mTexture.height };
+               Rectangle src = e.slot->getSourceRect();
+               Rectangle dest = { (float)e.offset.x, (float)e.offset.y, (float)e.slot->getWidth(), (float)e.slot->getHeight() };
                DrawTexturePro(e.slot->mTexture, src, dest, origin, 0.0f, WHITE);
             }
          }
       }
 
-      EndMode2D();
-      EndTextureMode();
+      EndScissorMode();
    }
+   
+   rlColorMask(true, true, true, true);
+   EndMode2D();
+   EndTextureMode();
+   
+   mRenderState.mZPlanesDirty = 0;
 }
 
 static Rectangle RTSourceRect(Rectangle normalCrop, S32 rtHeight)
@@ -244,11 +450,18 @@ static Rectangle RTSourceRect(Rectangle normalCrop, S32 rtHeight)
 
 void Room::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
 {
+   if (gGlobals.headless)
+   {
+      return;
+   }
+   
    if (mRenderState.backgroundImage.getNum() == 0)
    {
       updateResources();
    }
    
+   checkPendingResources();
+   
    // We need to maintain the original aspect ratio of the scene when drawing the image in respect to the scumm coord system
    
    Rectangle source = { (float)mRenderState.backgroundSR.point.x, 
@@ -276,7 +489,8 @@ void Room::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
    
    // z planes need to be kept current; these are handled by copying
    // the base planes + object planes to mask textures.
-   if (mRenderState.mZPlanesDirty || true)
+   syncZPlanes();
+   if (mRenderState.mZPlanesDirty)
    {
       updateZPlanes();
    }
@@ -286,9 +500,14 @@ void Room::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
    EndMode2D();
    
    Camera2D localCamera = MakeDefaultCamera();
-   BeginTextureMode(gGlobals.roomRt);
-   BeginMode2D(localCamera);
+   
+   // A prefetched room can still be decoding when it's entered; keep the
+   // last frame up rather than drawing it without a background
+   if (!mRenderState.mTexturesPending)
    {
+      BeginTextureMode(gGlobals.roomRt);
+      BeginMode2D(localCamera);
+      
       ClearBackground(RED);
 #if 1
       //DrawRectangle(0, 0, 300, 200, (Color){255,0,0,255});
@@ -296,11 +515,11 @@ void Room::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
       TextureSlot* slot = gTextureManager->resolveHandle(mRenderState.backgroundImage);
       if (slot)
       {
-         Rectangle localDest = { 0.0f, 0.0f, (float)slot->mTexture.width, (float)slot->mTexture.height };
+         Rectangle localDest = { 0.0f, 0.0f, (float)slot->getWidth(), (float)slot->getHeight() };
          if (zPlaneDebug)
          {
             // Z target is fullscreen too, so we just clip
-            DrawTexturePro(gGlobals.roomZPlaneRt[0].texture,
+            DrawTexturePro(gGlobals.roomZPlaneRt.texture,
                            RTSourceRect(source, 200),
                            localDest,
              origin, 0.0f, WHITE);
@@ -350,81 +569,72 @@ void Room::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
       std::vector<Actor*> sortedActors;
       sortedActors.reserve(objectList.size());
       
-      for (SimObject* obj : objectList)
       {
-         Actor* actor = dynamic_cast<Actor*>(obj);
-         if (actor)
-            sortedActors.push_back(actor);
-      }
-      
-      std::sort(sortedActors.begin(), sortedActors.end(), [](const Actor* a, const Actor* b){
-         if (a->mBounds.point.y != b->mBounds.point.y)
+         PROFILE_SCOPE("SortActors");
+         
+         for (SimObject* obj : objectList)
          {
-            return a->mBounds.point.y < b->mBounds.point.y;
+            Actor* actor = dynamic_cast<Actor*>(obj);
+            if (actor && actor->mLayer <= RoomRender::NumZPlanes)
+               sortedActors.push_back(actor);
          }
-
-         return a->getId() < b->getId();
-      });
-      
-      // Actors need to be masked by the current z planes.
-      // these need to be kept current
-      U32 lastActor = 0;
-      int locMask = GetShaderLocation(gGlobals.shaderMask, "maskTex");
-      int locRtSize = GetShaderLocation(gGlobals.shaderMask, "rtSizePx");
-      int locOff    = GetShaderLocation(gGlobals.shaderMask, "roomOffsetPx");
-      int locRoomSz = GetShaderLocation(gGlobals.shaderMask, "roomSizePx");
-      
-      Vector2 rtSize   = { (float)gGlobals.roomRt.texture.width, (float)gGlobals.roomRt.texture.height }; // 320,200
-      Vector2 roomOff  = { 0.0f, 0.0f };
-      Vector2 roomSize = { 320.0f, 200.0f };
+         
+         std::sort(sortedActors.begin(), sortedActors.end(), [](const Actor* a, const Actor* b){
+            if (a->mBounds.point.y != b->mBounds.point.y)
+            {
+               return a->mBounds.point.y < b->mBounds.point.y;
+            }
+            
+            return a->getId() < b->getId();
+         });
+         
+         // Layer 0 goes on top
+         std::stable_partition(sortedActors.begin(), sortedActors.end(), [](const Actor* a){
+            return a->mLayer != 0;
+         });
+      }
       
-      for (U32 zPlane=0; zPlane<RoomRender::NumZPlanes; zPlane++)
       {
-         // Start drawing using the zPlane RT as a mask
-         BeginBlendMode(BLEND_ALPHA);
-         BeginShaderMode(gGlobals.shaderMask);
-
-         Texture2D& tex = gGlobals.roomZPlaneRt[zPlane].texture; 
+         PROFILE_SCOPE("DrawActors");
+         
+         // Actors need to be masked by the current z planes. Each actor passes its
+         // layer through the vertex alpha so they can all be drawn in one pass.
+         int locMask = GetShaderLocation(gGlobals.shaderMask, "maskTex");
+         int locRtSize = GetShaderLocation(gGlobals.shaderMask, "rtSizePx");
+         int locOff    = GetShaderLocation(gGlobals.shaderMask, "roomOffsetPx");
+         int locRoomSz = GetShaderLocation(gGlobals.shaderMask, "roomSizePx");
          
-         SetTextureFilter(tex, TEXTURE_FILTER_POINT);
-         SetTextureWrap(tex, TEXTURE_WRAP_CLAMP);
+         Vector2 rtSize   = { (float)gGlobals.roomRt.texture.width, (float)gGlobals.roomRt.texture.height }; // 320,200
+         Vector2 roomOff  = { 0.0f, 0.0f };
+         Vector2 roomSize = { 320.0f, 200.0f };
          
-         SetShaderValueTexture(gGlobals.shaderMask, locMask, tex);
+         BeginBlendMode(BLEND_ALPHA);
+         BeginShaderMode(gGlobals.shaderMask);
+         gSpriteBatch.begin(BLEND_ALPHA);
          
+         SetShaderValueTexture(gGlobals.shaderMask, locMask, gGlobals.roomZPlaneRt.texture);
          SetShaderValue(gGlobals.shaderMask, locRtSize, &rtSize, SHADER_UNIFORM_VEC2);
          SetShaderValue(gGlobals.shaderMask, locOff,    &roomOff, SHADER_UNIFORM_VEC2);
          SetShaderValue(gGlobals.shaderMask, locRoomSz, &roomSize, SHADER_UNIFORM_VEC2);
-      
          
-         for (Actor* obj : sortedActors)
+         for (Actor* actor : sortedActors)
          {
-            Actor* actor = dynamic_cast<Actor*>(obj);
-            if (actor && actor->mLayer == zPlane+1)
-            {
-               // NOTE: actors can have costume parts all over the place,
-               // so we just use the rooms clip rect here.
-               Point2I childPosition = actor->getAnchorPosition();
-               RectI childClip(actor->getBoundedPosition(), actor->getBoundedExtent());
-               actor->onRender(childPosition, childClip, localCamera);
-            }
+            // NOTE: actors can have costume parts all over the place,
+            // so we just use the rooms clip rect here.
+            Point2I childPosition = actor->getAnchorPosition();
+            RectI childClip(actor->getBoundedPosition(), actor->getBoundedExtent());
+            actor->onRender(childPosition, childClip, localCamera);
          }
          
-         EndBlendMode();
-         EndShaderMode();
+         gSpriteBatch.end();
          
-         //break;
-      }
-      
-      // Draw layer 0 on top
-      for (Actor* obj : sortedActors)
-      {
-         Actor* actor = dynamic_cast<Actor*>(obj);
-         if (actor && actor->mLayer == 0)
+         for (Actor* actor : sortedActors)
          {
-            Point2I childPosition = actor->getAnchorPosition();
-            RectI childClip(actor->getBoundedPosition(), actor->getBoundedExtent());
-            actor->onRender(childPosition, childClip, localCamera);
+            actor->renderDebug();
          }
+         
+         EndShaderMode();
+         EndBlendMode();
       }
       
       // Unset message if not in proper room
@@ -460,9 +670,9 @@ void Room::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
       
 #endif
       
+      EndMode2D();
+      EndTextureMode();
    }
-   EndMode2D();
-   EndTextureMode();
    
    // Restore 2d mode
    BeginMode2D(localCamera);
@@ -514,10 +724,37 @@ void Room::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
    BeginMode2D(globalCam);
 }
 
+void Room::addObject(SimObject* obj)
+{
+   Parent::addObject(obj);
+   
+   Actor* actor = dynamic_cast<Actor*>(obj);
+   if (actor && actor->getGroup() == this)
+   {
+      mActorList.add(actor);
+   }
+}
+
+void Room::removeObject(SimObject* obj)
+{
+   Actor* actor = dynamic_cast<Actor*>(obj);
+   if (actor)
+   {
+      mActorList.remove(actor);
+   }
+   
+   Parent::removeObject(obj);
+}
+
 void Room::onFixedTick(F32 dt)
 {
    mRenderState.updateTransition(dt);
    
+   {
+      PROFILE_SCOPE("Actors");
+      mActorList.tick(this);
+   }
+   
    if (mRenderState.transitionPos >= 1.0 &&
        !mRenderState.transitionEnded)
    {
@@ -543,6 +780,7 @@ void Room::initPersistFields()
    addField("boxFile", TypeString, Offset(mBoxFileName, Room));
    addField("zPlane", TypeString, Offset(mZPlaneFiles, Room), RoomRender::NumZPlanes);
    addField("stateFlags", TypeS32, Offset(mStateFlags, Room));
+   addField("actorAvoidance", TypeBool, Offset(mActorAvoidance, Room));
 }
 
 
@@ -558,6 +796,12 @@ void Room::onEnter()
       mRenderState.transitionPos = 1.0f;
    }
    
+   // Textures are dropped on leave, so pick them up again
+   if (mRenderState.backgroundImage.getNum() == 0)
+   {
+      updateResources();
+   }
+   
    if (isMethod("onPreEntry"))
    {
       SimFiberManager::ScheduleInfo initialInfo = {};
@@ -568,7 +812,7 @@ void Room::onEnter()
       KorkApi::FiberId fiberId = gFiberManager->spawnFiber(this, 2, cv, initialInfo);
    }
    
-   registerTickable();
+   registerTickable(TICK_WALK);
 }
 
 void Room::onLeave()
@@ -585,6 +829,15 @@ void Room::onLeave()
    }
    
    unregisterTickable();
+   
+   // Let go of the room textures so they can be evicted if we're over budget
+   mRenderState.backgroundImage = nullptr;
+   for (uint32_t i=0; i<RoomRender::NumZPlanes; i++)
+   {
+      mRenderState.zPlanes[i] = nullptr;
+   }
+   mRenderState.mTexturesPending = false;
+   gTextureManager->enforceBudget();
 }
 
 
@@ -637,6 +890,96 @@ bool Room::processInput(DBIEvent& event)
    return event.handled;
 }
 
+bool Room::findPath(S32 srcBox, S32 dstBox, Point2I start, Point2I end,
+                    std::vector<Point2I>& outWaypoints, std::vector<U16>& outBoxes)
+{
+   outWaypoints.clear();
+   outBoxes.clear();
+   
+   if (srcBox < 0 || dstBox < 0 || srcBox > 0xFFFF || dstBox > 0xFFFF)
+   {
+      return false;
+   }
+   
+   const U32 key = ((U32)srcBox << 16) | (U32)dstBox;
+   auto itr = mPathCache.find(key);
+   
+   if (itr != mPathCache.end() && itr->second.epoch == mBoxEpoch)
+   {
+      mPathCacheHits++;
+      itr->second.lastUse = ++mPathCacheClock;
+      if (!itr->second.found)
+      {
+         return false;
+      }
+      
+      outBoxes = itr->second.boxes;
+      mBoxes.BuildWaypoints(outBoxes, start, end, outWaypoints);
+      return true;
+   }
+   
+   mPathCacheMisses++;
+   bool found = mBoxes.FindPath(srcBox, dstBox, start, end, BoxInfo::IsWalkableBox, outWaypoints, outBoxes);
+   
+   if (itr == mPathCache.end() && mPathCache.size() >= PathCacheSize)
+   {
+      // Drop the least recently used route
+      auto oldest = mPathCache.begin();
+      for (auto it = mPathCache.begin(); it != mPathCache.end(); it++)
+      {
+         if (it->second.lastUse < oldest->second.lastUse)
+         {
+            oldest = it;
+         }
+      }
+      mPathCache.erase(oldest);
+   }
+   
+   PathCacheEntry& entry = mPathCache[key];
+   entry.epoch = mBoxEpoch;
+   entry.lastUse = ++mPathCacheClock;
+   entry.found = found;
+   entry.boxes = outBoxes;
+   
+   return found;
+}
+
+void Room::setBoxFlags(S32 box, U8 flags)
+{
+   if (box <= 0 || box >= (S32)mBoxes.boxes.size())
+   {
+      return;
+   }
+   
+   if (mBoxes.boxes[box].flags != flags)
+   {
+      mBoxes.boxes[box].flags = flags;
+      mBoxes.updateBoxScale(box);
+      
+      // Cached routes may go through (or around) this box
+      mBoxEpoch++;
+      
+      // Re-plan walks already heading through it. Walks without a planned
+      // route are following BOXM hops, so re-plan those too.
+      for (Actor* actor : mActorList.mActors)
+      {
+         ActorWalkState& walk = actor->mWalkState;
+         if (walk.mAction < ActorWalkState::ACTION_CHECK_MOVE)
+         {
+            continue;
+         }
+         
+         if (walk.mPathBoxes.empty() ||
+             std::find(walk.mPathBoxes.begin(), walk.mPathBoxes.end(), (U16)box) != walk.mPathBoxes.end())
+         {
+            walk.mWalkTarget = actor->mAnchor;
+            walk.mNeedPath = true;
+            walk.mAction = ActorWalkState::ACTION_CHECK_MOVE;
+         }
+      }
+   }
+}
+
 ConsoleMethodValue(Room, setTransitionMode, 5, 5, "mode, param, time")
 {
    object->setTransitionMode(vmPtr->valueAsInt(argv[2]), vmPtr->valueAsInt(argv[3]), vmPtr->valueAsFloat(argv[4]));
@@ -751,7 +1094,7 @@ void RoomObject::updateLayout(const RectI contentRect)
       RoomObjectState* curState = dynamic_cast<RoomObjectState*>(objectList[curStateIndex]);
       if (curState)
       {
-         resize(mAnchor, curState->mExtent);
+         resize(mAnchor, curState->getExtent());
       }
    }
 }
@@ -793,10 +1136,10 @@ void RoomObject::onRender(Point2I offset, RectI drawRect, Camera2D& globalCam)
       TextureSlot* slot = gTextureManager->resolveHandle(curState->mTexture);
       if (slot)
       {
-         Rectangle src = { 0.0f, 0.0f, (float)slot->mTexture.width, (float)slot->mTexture.height };
-         Rectangle dest = { (float)offset.x, (float)offset.y, (float)slot->mTexture.width, (float)slot->mTexture.height };
+         Rectangle src = slot->getSourceRect();
+         Rectangle dest = { (float)offset.x, (float)offset.y, (float)slot->getWidth(), (float)slot->getHeight() };
          
-         RectI fullDest = WorldRectToScreen(RectI(offset, Point2I(slot->mTexture.width, slot->mTexture.height)), globalCam);
+         RectI fullDest = WorldRectToScreen(RectI(offset, Point2I(slot->getWidth(), slot->getHeight())), globalCam);
          DrawTexturePro(slot->mTexture, src, dest, origin, 0.0f, debug? BLUE : WHITE);
       }
    }
@@ -864,20 +1207,14 @@ void RoomObjectState::updateResources()
    
    if (mImageFileName && mImageFileName[0] != '\0')
    {
-      mTexture = gTextureManager->loadTexture(mImageFileName);
-      
-      TextureSlot* slot = gTextureManager->resolveHandle(mTexture);
-      if (slot)
-      {
-         mExtent = Point2I(slot->mTexture.width, slot->mTexture.height);
-      }
+      mTexture = gTextureManager->loadTextureAsync(mImageFileName, mImageFileName, TextureManager::LOAD_ATLAS);
    }
 
    for (U32 i=0; i<RoomRender::NumZPlanes; i++)
    {
       if (mZPlaneFiles[i] && !mZPlaneFiles[0] != '\0')
       {
-         mZPlaneTextures[i] = gTextureManager->loadTexture(mZPlaneFiles[i]);
+         mZPlaneTextures[i] = gTextureManager->loadTextureAsync(mZPlaneFiles[i], mZPlaneFiles[i], 0);
       }
       else
       {
@@ -886,6 +1223,21 @@ void RoomObjectState::updateResources()
    }
 }
 
+// Size comes from the image, which may still be loading
+Point2I RoomObjectState::getExtent()
+{
+   if (mExtent.x == 0 && mExtent.y == 0)
+   {
+      TextureSlot* slot = gTextureManager->resolveHandle(mTexture);
+      if (slot)
+      {
+         mExtent = Point2I(slot->getWidth(), slot->getHeight());
+      }
+   }
+   
+   return mExtent;
+}
+
 bool RoomObjectState::onAdd()
 {
    if (Parent::onAdd())
@@ -913,6 +1265,7 @@ void RoomObjectState::enumerateRenderables(RoomRender::ObjectInfo& outState)
    if (slot)
    {
       outInfo.slot = slot;
+      outInfo.extent = Point2I(slot->getWidth(), slot->getHeight());
       outState.images.push_back(outInfo);
    }
 
@@ -922,6 +1275,7 @@ void RoomObjectState::enumerateRenderables(RoomRender::ObjectInfo& outState)
       if (slot)
       {
          outInfo.slot = slot;
+         outInfo.extent = Point2I(slot->getWidth(), slot->getHeight());
          outState.zPlanes[i].push_back(outInfo);
       }
    }
@@ -1044,6 +1398,54 @@ ConsoleFunctionValue(loadRoom, 2, 3, "(room, force)")
    {
       Con::errorf("Unable to load room %s", vmPtr->valueAsString(argv[1]));
    }
+   
+   return KorkApi::ConsoleValue();
+}
+
+ConsoleFunctionValue(prefetchRoom, 2, 2, "(room)")
+{
+   Room* room = nullptr;
+   if (!Sim::findObject(argv[1], room))
+   {
+      // Script has to run on this thread, everything else can wait
+      char filename[1024];
+      snprintf(filename, sizeof(filename), "scripts/rooms/%s.cs", vmPtr->valueAsString(argv[1]));
+      if (Platform::isFile(filename))
+      {
+         Con::exec(filename);
+      }
+      
+      if (!Sim::findObject(argv[1], room))
+      {
+         Con::errorf("Unable to prefetch room %s", vmPtr->valueAsString(argv[1]));
+         return KorkApi::ConsoleValue();
+      }
+   }
+   
+   room->prefetch();
+   return KorkApi::ConsoleValue();
+}
+
+ConsoleMethodValue(Room, prefetch, 2, 2, "")
+{
+   object->prefetch();
+   return KorkApi::ConsoleValue();
+}
+
+ConsoleMethodValue(Room, setBoxFlags, 4, 4, "(box, flags)")
+{
+   object->setBoxFlags(vmPtr->valueAsInt(argv[2]), (U8)vmPtr->valueAsInt(argv[3]));
+   return KorkApi::ConsoleValue();
+}
+
+ConsoleMethodValue(Room, getBoxFlags, 3, 3, "(box)")
+{
+   S32 box = vmPtr->valueAsInt(argv[2]);
+   if (box <= 0 || box >= (S32)object->mBoxes.boxes.size())
+   {
+      return KorkApi::ConsoleValue::makeUnsigned(0);
+   }
+   return KorkApi::ConsoleValue::makeUnsigned(object->mBoxes.boxes[box].flags);
 }
 
 ConsoleFunctionValue(getObjectAt, 3, 3, "(x,y)")
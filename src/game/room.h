@@ -57,6 +57,7 @@ struct RoomRender
       struct Entry
       {
          Point2I offset;
+         Point2I extent; // size when enumerated; 0 while still loading
          TextureSlot* slot;
       };
 
@@ -86,8 +87,16 @@ struct RoomRender
    TransitionInfo currentTransition;
    F32 transitionPos;
    
-   bool mZPlanesDirty;
+   U8 mZPlanesDirty; // mask of planes which need rebuilding
    bool transitionEnded;
+   bool mTexturesPending; // background or z planes still loading
+   U32 mTextureGeneration;
+   
+   RectI mZPlaneDirtyRect[NumZPlanes];
+   std::vector<ObjectInfo::Entry> mBuiltZPlanes[NumZPlanes]; // object planes currently in the RTs
+   
+   void markZPlanesDirty(U32 mask, RectI rect);
+   void markAllZPlanesDirty();
    
    static float smoothstep(float t);
 
@@ -110,9 +119,36 @@ public:
 
     U32 mTransFlags;
     U32 mStateFlags;
+   bool mActorAvoidance; // actors steer around each other while walking
    
    RoomRender mRenderState;
    BoxInfo mBoxes;
+   RoomActorList mActorList;
+   
+   enum
+   {
+      PathCacheSize = 32
+   };
+   
+   // Box chains from previous walks; waypoints are rebuilt from these since
+   // they depend on the exact start and end points
+   struct PathCacheEntry
+   {
+      U32 epoch;
+      U32 lastUse;
+      bool found;
+      std::vector<U16> boxes;
+   };
+   
+   std::unordered_map<U32, PathCacheEntry> mPathCache;
+   U32 mBoxEpoch;       // bumped when box flags change
+   U32 mPathCacheClock;
+   U32 mPathCacheHits;
+   U32 mPathCacheMisses;
+   
+   bool findPath(S32 srcBox, S32 dstBox, Point2I start, Point2I end,
+                 std::vector<Point2I>& outWaypoints, std::vector<U16>& outBoxes);
+   void setBoxFlags(S32 box, U8 flags);
    
    S32 findBoxContainingPoint(Point2I pos);
    Point2I projectPointOntoBox(Point2I pos, S32 box);
@@ -126,13 +162,21 @@ public:
    void onEnter();
    void onLeave();
    
+   virtual void addObject(SimObject* obj);
+   virtual void removeObject(SimObject* obj);
+   
    void setTransitionMode(U8 mode, U8 param, F32 time, bool force=false);
    
    virtual void resize(const Point2I newPosition, const Point2I newExtent);
    virtual void updateLayout(const RectI contentRect);
    
-   void updateResources();
+   // Loads the background and z planes; prefetch decodes them in the
+   // background, anything else needs them straight away
+   void updateResources(bool async = false);
+   void checkPendingResources();
+   void prefetch();
    
+   void syncZPlanes();
    void updateZPlanes();
    
    virtual void onRender(Point2I offset, RectI drawRect, Camera2D& globalCam);
@@ -217,6 +261,7 @@ public:
    RoomObjectState();
 
    void updateResources();
+   Point2I getExtent();
 
    bool onAdd();
    
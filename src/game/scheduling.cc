@@ -8,43 +8,114 @@
 //-----------------------------------------------------------------------------
 //
 
-std::vector<ITickable::TickableInfo> ITickable::smTickList;
+// Fibers can change anything on screen, so keep the frame pacer awake
+static inline void NoteFiberActivity()
+{
+   gGlobals.lastBusyTick = gGlobals.simTick;
+}
 
+// Ticks delayed fibers are due back on. A fiber can wake, change the scene
+// and end without waiting again, so the pacer is woken when it's due.
+static std::priority_queue<U64, std::vector<U64>, std::greater<U64>> sFiberWakeTicks;
 
-void ITickable::registerTickable()
+void NoteDueFiberWakes(U64 tick)
 {
-  TickableInfo info = {};
-  info.tickable = this;
-  info.registered = true;
-  smTickList.push_back(info);
+   bool due = false;
+   while (!sFiberWakeTicks.empty() && sFiberWakeTicks.top() <= tick)
+   {
+      sFiberWakeTicks.pop();
+      due = true;
+   }
+   
+   if (due)
+   {
+      NoteFiberActivity();
+   }
+}
+
+std::vector<ITickable*> ITickable::smTickList[ITickable::NumTickPhases];
+bool ITickable::smTickListDirty[ITickable::NumTickPhases];
+
+
+ITickable::~ITickable()
+{
+   unregisterTickable();
+}
+
+void ITickable::registerTickable(TickPhase phase)
+{
+   if (mTickSlot >= 0)
+   {
+      if (mTickPhase == phase)
+      {
+         return;
+      }
+      unregisterTickable();
+   }
+   
+   mTickPhase = phase;
+   mTickSlot = (S32)smTickList[phase].size();
+   smTickList[phase].push_back(this);
 }
 
 void ITickable::unregisterTickable()
 {
-  auto itr = std::find_if(smTickList.begin(), smTickList.end(), [this](const TickableInfo& info){
-     return info.tickable == this;
-  });
-  
-  if (itr != smTickList.end())
-  {
-     itr->registered = false;
-  }
+   if (mTickSlot < 0)
+   {
+      return;
+   }
+   
+   smTickList[mTickPhase][mTickSlot] = nullptr;
+   smTickListDirty[mTickPhase] = true;
+   mTickSlot = -1;
 }
 
 void ITickable::doFixedTick(F32 dt)
 {
-  for (TickableInfo info : smTickList)
-  {
-     info.tickable->onFixedTick(dt);
-  }
-  
-  smTickList.erase(
-      std::remove_if(smTickList.begin(), smTickList.end(),
-          [](const TickableInfo& info) {
-              return !info.registered;
-          }),
-                   smTickList.end()
-  );
+   PROFILE_SCOPE("Tick");
+   
+   // Anything registered during the tick starts next tick, whichever phase
+   // it goes into
+   U32 counts[NumTickPhases];
+   for (U32 phase=0; phase<NumTickPhases; phase++)
+   {
+      counts[phase] = (U32)smTickList[phase].size();
+   }
+   
+   for (U32 phase=0; phase<NumTickPhases; phase++)
+   {
+      std::vector<ITickable*>& list = smTickList[phase];
+      
+      const U32 count = counts[phase];
+      for (U32 i=0; i<count; i++)
+      {
+         if (list[i])
+         {
+            list[i]->onFixedTick(dt);
+         }
+      }
+   }
+   
+   for (U32 phase=0; phase<NumTickPhases; phase++)
+   {
+      if (!smTickListDirty[phase])
+      {
+         continue;
+      }
+      
+      std::vector<ITickable*>& list = smTickList[phase];
+      U32 used = 0;
+      for (U32 i=0; i<list.size(); i++)
+      {
+         if (list[i])
+         {
+            list[i]->mTickSlot = (S32)used;
+            list[used++] = list[i];
+         }
+      }
+      list.resize(used);
+      smTickListDirty[phase] = false;
+   }
 }
 
 
@@ -55,6 +126,7 @@ IMPLEMENT_CONOBJECT(SentenceQueueManager);
 
 ConsoleFunctionValue(yieldFiber, 2, 2, "value")
 {
+   NoteFiberActivity();
    vmPtr->suspendCurrentFiber();
    return argv[1]; // NOTE: this will be set as yield value
 }
@@ -64,6 +136,8 @@ ConsoleFunctionValue(breakFiber, 1, 1, "")
    SimFiberManager::ScheduleParam sp;
    sp.flagMask = 0;
    sp.minTime = gFiberManager->getCurrentTick() + 1;
+   NoteFiberActivity();
+   sFiberWakeTicks.push(sp.minTime);
    gFiberManager->setFiberWaitMode(vmPtr->getCurrentFiber(), SimFiberManager::WAIT_TICK, sp);
    vmPtr->suspendCurrentFiber();
    return KorkApi::ConsoleValue();
@@ -74,6 +148,8 @@ ConsoleFunctionValue(delayFiber, 2, 2, "ticks")
    SimFiberManager::ScheduleParam sp;
    sp.flagMask = 0;
    sp.minTime = gFiberManager->getCurrentTick() + vmPtr->valueAsInt(argv[1]);
+   NoteFiberActivity();
+   sFiberWakeTicks.push(sp.minTime);
    gFiberManager->setFiberWaitMode(vmPtr->getCurrentFiber(), SimFiberManager::WAIT_TICK, sp);
    vmPtr->suspendCurrentFiber();
    return KorkApi::ConsoleValue();
@@ -85,6 +161,7 @@ ConsoleFunctionValue(spawnFiber, 3, 20, "flagMask, func, ...")
    initialInfo.waitMode = SimFiberManager::WAIT_REMOVE;
    initialInfo.param.flagMask = (U64)vmPtr->valueAsInt(argv[1]);
    KorkApi::FiberId fiberId = gFiberManager->spawnFiber(NULL, argc-2, argv+2, initialInfo);
+   NoteFiberActivity();
    
    if (vmPtr->getFiberState(fiberId) < KorkApi::FiberRunResult::State::ERROR)
    {
@@ -113,6 +190,7 @@ ConsoleMethodValue(SimObject, spawnFiber, 4, 20, "flagMask, func, ...")
    }
    
    KorkApi::FiberId fiberId = gFiberManager->spawnFiber(object, argc-2, params.data(), initialInfo);
+   NoteFiberActivity();
    
    if (vmPtr->getFiberState(fiberId) < KorkApi::FiberRunResult::State::ERROR)
    {
@@ -134,6 +212,7 @@ ConsoleFunctionValue(isFiberRunning, 2, 2, "fiberId")
 ConsoleFunctionValue(stopFiber, 2, 2, "fiberId")
 {
    KorkApi::FiberId fiberId = (KorkApi::FiberId)vmPtr->valueAsInt(argv[1]);
+   NoteFiberActivity();
    gFiberManager->cleanupFiber(fiberId);
    return KorkApi::ConsoleValue();
 }
@@ -176,6 +255,7 @@ ConsoleFunctionValue(waitForMessage, 1, 1, "")
    SimFiberManager::ScheduleParam sp;
    sp.flagMask = SCHEDULE_FLAG_MESSAGE;
    sp.minTime = 0;
+   NoteFiberActivity();
    gFiberManager->setFiberWaitMode(vmPtr->getCurrentFiber(), SimFiberManager::WAIT_FLAGS_CLEAR, sp);
    vmPtr->suspendCurrentFiber();
    return KorkApi::ConsoleValue();
@@ -186,6 +266,7 @@ ConsoleFunctionValue(waitForCamera, 1, 1, "")
    SimFiberManager::ScheduleParam sp;
    sp.flagMask = SCHEDULE_FLAG_CAMERA_MOVING;
    sp.minTime = 0;
+   NoteFiberActivity();
    gFiberManager->setFiberWaitMode(vmPtr->getCurrentFiber(), SimFiberManager::WAIT_FLAGS_CLEAR, sp);
    vmPtr->suspendCurrentFiber();
    return KorkApi::ConsoleValue();
@@ -196,6 +277,7 @@ ConsoleFunctionValue(waitForSentence, 1, 1, "")
    SimFiberManager::ScheduleParam sp;
    sp.flagMask = SCHEDULE_FLAG_SENTENCE_BUSY;
    sp.minTime = 0;
+   NoteFiberActivity();
    gFiberManager->setFiberWaitMode(vmPtr->getCurrentFiber(), SimFiberManager::WAIT_FLAGS_CLEAR, sp);
    vmPtr->suspendCurrentFiber();
    return KorkApi::ConsoleValue();
@@ -206,6 +288,7 @@ ConsoleFunctionValue(waitForFiber, 2, 2, "")
    SimFiberManager::ScheduleParam sp;
    sp.flagMask = 0;
    sp.minTime = vmPtr->valueAsInt(argv[1]);
+   NoteFiberActivity();
    gFiberManager->setFiberWaitMode(vmPtr->getCurrentFiber(), SimFiberManager::WAIT_FIBER, sp);
    vmPtr->suspendCurrentFiber();
    return KorkApi::ConsoleValue();
@@ -234,6 +317,8 @@ bool SentenceQueueManager::pushItem(SimObjectId verb, SimObjectId objA, SimObjec
 
 void SentenceQueueManager::execItem()
 {
+   PROFILE_SCOPE("SentenceQueue");
+   
    // Wait until last fiber has stopped running
    if (isBusy())
    {
@@ -9,22 +9,43 @@
 //
 
 
+// Anything stepped once per fixed tick. Tickables are dispatched phase by
+// phase, in registration order within a phase. Each one records its own slot
+// so unregistering just blanks it; the lists are compacted after the tick.
 class ITickable
 {
-   struct TickableInfo
+public:
+   enum TickPhase
    {
-      ITickable* tickable;
-      bool registered;
+      TICK_INPUT,
+      TICK_SCRIPT,
+      TICK_WALK,
+      TICK_ANIMATION,
+      TICK_AUDIO,
+      NumTickPhases
    };
- 
-public:
+   
+   ITickable() : mTickSlot(-1), mTickPhase(TICK_SCRIPT) {;}
+   virtual ~ITickable();
+   
    virtual void onFixedTick(F32 dt) = 0;
    
-   void registerTickable();
+   void registerTickable(TickPhase phase = TICK_SCRIPT);
    
    void unregisterTickable();
    
+   inline bool isTickRegistered() const { return mTickSlot >= 0; }
+   
    static void doFixedTick(F32 dt);
    
-   static std::vector<TickableInfo> smTickList;
+   static std::vector<ITickable*> smTickList[NumTickPhases];
+   static bool smTickListDirty[NumTickPhases]; // has blank slots
+   
+private:
+   S32 mTickSlot;
+   TickPhase mTickPhase;
 };
+
+// Keeps low power mode awake on ticks where a delayed fiber resumes; call
+// before execFibers with the tick it's about to run
+void NoteDueFiberWakes(U64 tick);
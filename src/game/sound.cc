@@ -19,13 +19,16 @@ Sound::Sound()
 	mPath = StringTable->EmptyString;
 	mSound = {};
 	mChannel = 0;
+	mLoaded = false;
 }
 
 bool Sound::onAdd()
 {
 	if (Parent::onAdd())
 	{
-		updateResources();
+		// Room sounds are declared outside their rooms, so nothing else
+		// would get to them before the first play()
+		prefetch();
 		return true;
 	}
 	return false;
@@ -33,17 +36,55 @@ bool Sound::onAdd()
 
 void Sound::onRemove()
 {
-	::UnloadSound(mSound);
+	if (!gGlobals.headless)
+	{
+		finishLoad();
+		::UnloadSound(mSound);
+	}
 	Parent::onRemove();
 }
 
-void Sound::updateResources()
+void Sound::prefetch()
 {
-	mSound = ::LoadSound(mPath);
+	if (gGlobals.headless || mLoaded || mPendingWave.valid() || !gTextureManager)
+	{
+		return;
+	}
+	
+	mPendingWave = gTextureManager->loadWaveAsync(mPath);
+}
+
+// Creates the audio buffer from the decoded wave; waits if it's not done yet
+void Sound::finishLoad()
+{
+	if (!mPendingWave.valid())
+	{
+		return;
+	}
+	
+	::Wave wave = mPendingWave.get();
+	if (wave.data)
+	{
+		mSound = ::LoadSoundFromWave(wave);
+		::UnloadWave(wave);
+	}
+	mLoaded = true;
 }
 
 void Sound::play()
 {
+	if (gGlobals.headless)
+	{
+		return;
+	}
+	
+	finishLoad();
+	if (!mLoaded)
+	{
+		mSound = ::LoadSound(mPath);
+		mLoaded = true;
+	}
+	
 	if (mChannel < AUDIO_CHANNEL_COUNT)
 	{
 		::SetSoundVolume(mSound, gGlobals.mChannelVolume[mChannel]);
@@ -64,4 +105,10 @@ ConsoleMethodValue(Sound, play, 2, 2, "")
 	return KorkApi::ConsoleValue();
 }
 
+ConsoleMethodValue(Sound, prefetch, 2, 2, "")
+{
+	object->prefetch();
+	return KorkApi::ConsoleValue();
+}
+
 END_SW_NS
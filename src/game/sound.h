@@ -20,6 +20,8 @@ public:
    StringTableEntry mPath;
    U32 mChannel;
    ::Sound mSound;
+   std::future<::Wave> mPendingWave; // decoding on the texture worker
+   bool mLoaded;                     // decode tried, whether or not it worked
 
    Sound();
 
@@ -28,7 +30,8 @@ public:
 
    void play();
 
-   void updateResources();
+   void prefetch();
+   void finishLoad();
 
    static void initPersistFields();
    
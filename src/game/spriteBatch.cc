@@ -0,0 +1,144 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+#include "engine.h"
+
+
+SpriteBatch gSpriteBatch;
+
+static inline bool RectanglesOverlap(const ::Rectangle& a, const ::Rectangle& b)
+{
+   return a.x < b.x + b.width && b.x < a.x + a.width &&
+          a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+static inline void RectangleUnion(::Rectangle& a, const ::Rectangle& b)
+{
+   F32 minX = getMin(a.x, b.x);
+   F32 minY = getMin(a.y, b.y);
+   F32 maxX = getMax(a.x + a.width, b.x + b.width);
+   F32 maxY = getMax(a.y + a.height, b.y + b.height);
+   a = (::Rectangle){ minX, minY, maxX - minX, maxY - minY };
+}
+
+SpriteBatch::SpriteBatch() :
+mBaseBlendMode(BLEND_ALPHA),
+mLastQuads(0),
+mLastGroups(0),
+mActive(false)
+{
+}
+
+void SpriteBatch::begin(S32 baseBlendMode)
+{
+   mBaseBlendMode = baseBlendMode;
+   mQuads.clear();
+   mGroups.clear();
+   mActive = true;
+}
+
+void SpriteBatch::submit(const ::Texture2D& texture, ::Rectangle source, ::Rectangle dest, ::Color tint, S32 blendMode)
+{
+   if (!mActive)
+   {
+      // Nothing to batch with
+      if (blendMode != BLEND_INHERIT) BeginBlendMode(blendMode);
+      DrawTexturePro(texture, source, dest, (Vector2){0.0f, 0.0f}, 0.0f, tint);
+      if (blendMode != BLEND_INHERIT) EndBlendMode();
+      return;
+   }
+
+   if (blendMode == BLEND_INHERIT)
+   {
+      blendMode = mBaseBlendMode;
+   }
+
+   Quad quad;
+   quad.texture = texture;
+   quad.source = source;
+   quad.dest = dest;
+   quad.tint = tint;
+   quad.blendMode = blendMode;
+   quad.group = (U32)mGroups.size();
+
+   // Walk back through the groups; join the nearest matching one unless
+   // something in between overlaps this quad.
+   for (S32 i=(S32)mGroups.size()-1; i>=0; i--)
+   {
+      Group& group = mGroups[i];
+      if (group.textureId == texture.id && group.blendMode == blendMode)
+      {
+         quad.group = i;
+         RectangleUnion(group.bounds, dest);
+         break;
+      }
+
+      if (RectanglesOverlap(group.bounds, dest))
+      {
+         break;
+      }
+   }
+
+   if (quad.group == mGroups.size())
+   {
+      Group group;
+      group.textureId = texture.id;
+      group.blendMode = blendMode;
+      group.bounds = dest;
+      mGroups.push_back(group);
+   }
+
+   mQuads.push_back(quad);
+}
+
+void SpriteBatch::end()
+{
+   mActive = false;
+   mLastQuads = (U32)mQuads.size();
+   mLastGroups = (U32)mGroups.size();
+
+   if (mQuads.empty())
+   {
+      return;
+   }
+
+   mOrder.resize(mQuads.size());
+   for (U32 i=0; i<mOrder.size(); i++)
+   {
+      mOrder[i] = i;
+   }
+
+   std::stable_sort(mOrder.begin(), mOrder.end(), [this](U32 a, U32 b){
+      return mQuads[a].group < mQuads[b].group;
+   });
+
+   // raylib merges consecutive draws with the same texture, so this ends up
+   // as one draw call per group.
+   S32 curBlendMode = mBaseBlendMode;
+   const Vector2 origin = { 0.0f, 0.0f };
+
+   for (U32 idx : mOrder)
+   {
+      Quad& quad = mQuads[idx];
+      if (quad.blendMode != curBlendMode)
+      {
+         BeginBlendMode(quad.blendMode);
+         curBlendMode = quad.blendMode;
+      }
+
+      DrawTexturePro(quad.texture, quad.source, quad.dest, origin, 0.0f, quad.tint);
+   }
+
+   if (curBlendMode != mBaseBlendMode)
+   {
+      BeginBlendMode(mBaseBlendMode);
+   }
+
+   mQuads.clear();
+   mGroups.clear();
+}
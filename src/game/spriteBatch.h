@@ -0,0 +1,61 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+
+// Collects textured quads between begin() and end(), then draws them grouped
+// by texture and blend mode. A quad is only moved earlier to join a group if
+// it doesn't overlap anything drawn in between, so the result is the same as
+// drawing everything in submission order.
+class SpriteBatch
+{
+public:
+   enum
+   {
+      BLEND_INHERIT = -1 // use the mode passed to begin()
+   };
+
+   struct Quad
+   {
+      ::Texture2D texture;
+      ::Rectangle source;
+      ::Rectangle dest;
+      ::Color tint;
+      S32 blendMode;
+      U32 group;
+   };
+
+   struct Group
+   {
+      U32 textureId;
+      S32 blendMode;
+      ::Rectangle bounds;
+   };
+
+   SpriteBatch();
+
+   void begin(S32 baseBlendMode);
+   void submit(const ::Texture2D& texture, ::Rectangle source, ::Rectangle dest, ::Color tint, S32 blendMode);
+   void end();
+
+   inline bool isActive() const { return mActive; }
+   inline U32 getLastQuadCount() const { return mLastQuads; }
+   inline U32 getLastGroupCount() const { return mLastGroups; }
+
+private:
+   std::vector<Quad> mQuads;
+   std::vector<Group> mGroups;
+   std::vector<U32> mOrder;
+   S32 mBaseBlendMode;
+   U32 mLastQuads;
+   U32 mLastGroups;
+   bool mActive;
+};
+
+extern SpriteBatch gSpriteBatch;
@@ -0,0 +1,447 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+#include "engine.h"
+
+#if !defined(TORQUE_OS_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile() : mData(NULL), mSize(0), mMapped(false)
+{
+}
+
+MappedFile::~MappedFile()
+{
+   close();
+}
+
+bool MappedFile::open(const char* path)
+{
+   close();
+
+#if !defined(TORQUE_OS_WIN32)
+   int fd = ::open(path, O_RDONLY);
+   if (fd >= 0)
+   {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size > 0)
+      {
+         void* ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (ptr != MAP_FAILED)
+         {
+            mData = (const U8*)ptr;
+            mSize = (U32)st.st_size;
+            mMapped = true;
+         }
+      }
+      ::close(fd);
+
+      if (mMapped)
+      {
+         return true;
+      }
+   }
+#endif
+
+   FileStream fs;
+   if (!fs.open(path, FileStream::Read))
+   {
+      return false;
+   }
+
+   mBuffer.resize(fs.getStreamSize());
+   if (mBuffer.empty() || !fs.read((U32)mBuffer.size(), mBuffer.data()))
+   {
+      mBuffer.clear();
+      return false;
+   }
+
+   mData = mBuffer.data();
+   mSize = (U32)mBuffer.size();
+   return true;
+}
+
+void MappedFile::close()
+{
+#if !defined(TORQUE_OS_WIN32)
+   if (mMapped)
+   {
+      munmap((void*)mData, mSize);
+   }
+#endif
+
+   mBuffer.clear();
+   mData = NULL;
+   mSize = 0;
+   mMapped = false;
+}
+
+
+template<typename T> static void WriteSection(std::vector<U8>& out, WalkMapSection& section, const T* data, U32 count)
+{
+   out.resize((out.size() + 7) & ~(size_t)7);
+   section.offset = (U32)out.size();
+   section.count = count;
+
+   const U8* bytes = (const U8*)data;
+   out.insert(out.end(), bytes, bytes + (sizeof(T) * count));
+}
+
+template<typename T> static const T* GetSection(const U8* data, U32 size, const WalkMapSection& section)
+{
+   if (section.offset % alignof(T) != 0 ||
+       section.offset > size ||
+       (U64)section.count * sizeof(T) > size - section.offset)
+   {
+      return NULL;
+   }
+   return (const T*)(data + section.offset);
+}
+
+// Offset tables must start at 0, never go backwards and end at the size of
+// the list they index, otherwise a range could run off the end
+static bool StartsValid(const std::vector<U32>& starts, size_t listSize)
+{
+   if (starts.empty() || starts.front() != 0 || starts.back() != listSize)
+   {
+      return false;
+   }
+
+   for (U32 i=1; i<starts.size(); i++)
+   {
+      if (starts[i] < starts[i-1] || starts[i] > listSize)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+// 64-bit FNV-1a; edits that keep the .box the same size still change this
+U64 BoxInfo::hashSource(const U8* data, U32 size)
+{
+   U64 hash = 14695981039346656037ull;
+   for (U32 i=0; i<size; i++)
+   {
+      hash ^= data[i];
+      hash *= 1099511628211ull;
+   }
+   return hash;
+}
+
+bool BoxInfo::writeBaked(const char* path, U64 sourceHash)
+{
+   ensureSpatialIndex();
+   ensureScaleTables();
+   ensureAdjacency();
+
+   const U32 n = boxes.size();
+   if (n > 255)
+   {
+      Con::errorf("compileWalkMap: too many boxes for %s (%u)", path, n);
+      return false;
+   }
+   portals.resize((size_t)n * n);
+
+   WalkMapHeader header = {};
+   header.magic = WalkMapHeader::FileMagic;
+   header.version = WalkMapHeader::FileVersion;
+   header.sourceHash = sourceHash;
+   header.numSections = WalkMapSection::NumSections;
+   header.gridOriginX = gridOrigin.x;
+   header.gridOriginY = gridOrigin.y;
+   header.gridWidth = gridWidth;
+   header.gridHeight = gridHeight;
+
+   WalkMapSection sections[WalkMapSection::NumSections] = {};
+
+   std::vector<WalkMapBox> bakedBoxes(n);
+   std::vector<char> names;
+   for (U32 i=0; i<n; i++)
+   {
+      bakedBoxes[i].nameOffset = (U32)names.size();
+      bakedBoxes[i].startPoint = boxes[i].startPoint;
+      bakedBoxes[i].numPoints = boxes[i].numPoints;
+      bakedBoxes[i].scale = boxes[i].scale;
+      bakedBoxes[i].mask = boxes[i].mask;
+      bakedBoxes[i].flags = boxes[i].flags;
+      names.insert(names.end(), boxes[i].name.begin(), boxes[i].name.end());
+      names.push_back('\0');
+   }
+
+   std::vector<S32> bakedPoints(points.size() * 2);
+   for (U32 i=0; i<points.size(); i++)
+   {
+      bakedPoints[i*2] = points[i].x;
+      bakedPoints[i*2+1] = points[i].y;
+   }
+
+   std::vector<WalkMapPortal> bakedPortals(portals.size());
+   for (U32 i=0; i<portals.size(); i++)
+   {
+      const Portal& portal = portals[i];
+      WalkMapPortal& baked = bakedPortals[i];
+      baked = {};
+      baked.midOnSrc[0] = portal.midOnSrc.x;
+      baked.midOnSrc[1] = portal.midOnSrc.y;
+      baked.overlapA[0] = portal.overlapA.x;
+      baked.overlapA[1] = portal.overlapA.y;
+      baked.overlapB[0] = portal.overlapB.x;
+      baked.overlapB[1] = portal.overlapB.y;
+      baked.hasSegment = portal.hasSegment;
+      baked.valid = portal.valid;
+   }
+
+   std::vector<S32> bakedBounds(boxBounds.size() * 4);
+   for (U32 i=0; i<boxBounds.size(); i++)
+   {
+      bakedBounds[i*4] = boxBounds[i].point.x;
+      bakedBounds[i*4+1] = boxBounds[i].point.y;
+      bakedBounds[i*4+2] = boxBounds[i].extent.x;
+      bakedBounds[i*4+3] = boxBounds[i].extent.y;
+   }
+
+   std::vector<F32> slotScales;
+   for (U32 i=0; i<NumScaleSlots; i++)
+   {
+      slotScales.insert(slotScales.end(), slotScaleTables[i].begin(), slotScaleTables[i].end());
+   }
+
+   std::vector<WalkMapBoxScale> bakedBoxScales(boxScales.size());
+   for (U32 i=0; i<boxScales.size(); i++)
+   {
+      bakedBoxScales[i].scale = boxScales[i].scale;
+      bakedBoxScales[i].slot = boxScales[i].slot;
+   }
+
+   std::vector<U8> out(sizeof(WalkMapHeader) + sizeof(sections));
+   WriteSection(out, sections[WalkMapSection::BOXES], bakedBoxes.data(), n);
+   WriteSection(out, sections[WalkMapSection::NAMES], names.data(), (U32)names.size());
+   WriteSection(out, sections[WalkMapSection::POINTS], bakedPoints.data(), (U32)bakedPoints.size());
+   WriteSection(out, sections[WalkMapSection::SCALE_BANDS], scaleBands.data(), (U32)scaleBands.size());
+   WriteSection(out, sections[WalkMapSection::HOPS], nextBoxHopList.data(), (U32)nextBoxHopList.size());
+   WriteSection(out, sections[WalkMapSection::PORTALS], bakedPortals.data(), (U32)bakedPortals.size());
+   WriteSection(out, sections[WalkMapSection::BOX_BOUNDS], bakedBounds.data(), (U32)bakedBounds.size());
+   WriteSection(out, sections[WalkMapSection::GRID_CELLS], gridCellStart.data(), (U32)gridCellStart.size());
+   WriteSection(out, sections[WalkMapSection::GRID_BOXES], gridBoxes.data(), (U32)gridBoxes.size());
+   WriteSection(out, sections[WalkMapSection::ADJACENCY_START], adjacencyStart.data(), (U32)adjacencyStart.size());
+   WriteSection(out, sections[WalkMapSection::ADJACENCY], adjacency.data(), (U32)adjacency.size());
+   WriteSection(out, sections[WalkMapSection::DEFAULT_SCALE], defaultScaleTable.data(), (U32)defaultScaleTable.size());
+   WriteSection(out, sections[WalkMapSection::SLOT_SCALE], slotScales.data(), (U32)slotScales.size());
+   WriteSection(out, sections[WalkMapSection::BOX_SCALES], bakedBoxScales.data(), (U32)bakedBoxScales.size());
+
+   memcpy(out.data(), &header, sizeof(header));
+   memcpy(out.data() + sizeof(header), sections, sizeof(sections));
+
+   FileStream fs;
+   if (!fs.open(path, FileStream::Write))
+   {
+      Con::errorf("compileWalkMap: couldn't open %s for writing", path);
+      return false;
+   }
+
+   fs.write((U32)out.size(), out.data());
+   fs.close();
+   return true;
+}
+
+bool BoxInfo::readBaked(const char* path, U64 sourceHash)
+{
+   MappedFile file;
+   if (!file.open(path))
+   {
+      return false;
+   }
+
+   const U8* data = file.getData();
+   const U32 size = file.getSize();
+
+   if (size < sizeof(WalkMapHeader) + sizeof(WalkMapSection) * WalkMapSection::NumSections)
+   {
+      return false;
+   }
+
+   const WalkMapHeader* header = (const WalkMapHeader*)data;
+   if (header->magic != WalkMapHeader::FileMagic ||
+       header->version != WalkMapHeader::FileVersion ||
+       header->numSections != WalkMapSection::NumSections ||
+       header->sourceHash != sourceHash)
+   {
+      return false;
+   }
+
+   const WalkMapSection* sections = (const WalkMapSection*)(data + sizeof(WalkMapHeader));
+
+   const WalkMapBox* bakedBoxes = GetSection<WalkMapBox>(data, size, sections[WalkMapSection::BOXES]);
+   const char* names = GetSection<char>(data, size, sections[WalkMapSection::NAMES]);
+   const S32* bakedPoints = GetSection<S32>(data, size, sections[WalkMapSection::POINTS]);
+   const ScaleInfo* bakedBands = GetSection<ScaleInfo>(data, size, sections[WalkMapSection::SCALE_BANDS]);
+   const U8* hops = GetSection<U8>(data, size, sections[WalkMapSection::HOPS]);
+   const WalkMapPortal* bakedPortals = GetSection<WalkMapPortal>(data, size, sections[WalkMapSection::PORTALS]);
+   const S32* bakedBounds = GetSection<S32>(data, size, sections[WalkMapSection::BOX_BOUNDS]);
+   const U32* cells = GetSection<U32>(data, size, sections[WalkMapSection::GRID_CELLS]);
+   const U16* cellBoxes = GetSection<U16>(data, size, sections[WalkMapSection::GRID_BOXES]);
+   const U32* adjStart = GetSection<U32>(data, size, sections[WalkMapSection::ADJACENCY_START]);
+   const U16* adj = GetSection<U16>(data, size, sections[WalkMapSection::ADJACENCY]);
+   const F32* defaultScales = GetSection<F32>(data, size, sections[WalkMapSection::DEFAULT_SCALE]);
+   const F32* slotScales = GetSection<F32>(data, size, sections[WalkMapSection::SLOT_SCALE]);
+   const WalkMapBoxScale* bakedBoxScales = GetSection<WalkMapBoxScale>(data, size, sections[WalkMapSection::BOX_SCALES]);
+
+   if (!bakedBoxes || !names || !bakedPoints || !bakedBands || !hops || !bakedPortals ||
+       !bakedBounds || !cells || !cellBoxes || !adjStart || !adj || !defaultScales ||
+       !slotScales || !bakedBoxScales)
+   {
+      Con::errorf("Walk map %s is truncated", path);
+      return false;
+   }
+
+   // Sizes are compared in U64 so a huge count can't wrap round to match
+   const U64 n = sections[WalkMapSection::BOXES].count;
+   const U32 numNames = sections[WalkMapSection::NAMES].count;
+   const U64 scaleTableSize = sections[WalkMapSection::DEFAULT_SCALE].count;
+
+   // Box ids have to fit below the 255 hop sentinel
+   if (n > 255 ||
+       sections[WalkMapSection::PORTALS].count != n * n ||
+       sections[WalkMapSection::BOX_BOUNDS].count != n * 4 ||
+       sections[WalkMapSection::ADJACENCY_START].count != n + 1 ||
+       sections[WalkMapSection::BOX_SCALES].count != n ||
+       (sections[WalkMapSection::HOPS].count != 0 && sections[WalkMapSection::HOPS].count != n * n) ||
+       sections[WalkMapSection::SLOT_SCALE].count != scaleTableSize * NumScaleSlots ||
+       (numNames > 0 && names[numNames - 1] != '\0'))
+   {
+      Con::errorf("Walk map %s is malformed", path);
+      return false;
+   }
+
+   reset();
+
+   boxes.resize(n);
+   for (U32 i=0; i<n; i++)
+   {
+      const WalkMapBox& baked = bakedBoxes[i];
+      Box& box = boxes[i];
+      box.name = baked.nameOffset < numNames ? names + baked.nameOffset : "";
+      box.startPoint = baked.startPoint;
+      box.numPoints = baked.numPoints;
+      box.scale = baked.scale;
+      box.mask = baked.mask;
+      box.flags = baked.flags;
+   }
+
+   const U32 numPoints = sections[WalkMapSection::POINTS].count / 2;
+   points.resize(numPoints);
+   for (U32 i=0; i<numPoints; i++)
+   {
+      points[i] = Point2I(bakedPoints[i*2], bakedPoints[i*2+1]);
+   }
+
+   scaleBands.assign(bakedBands, bakedBands + sections[WalkMapSection::SCALE_BANDS].count);
+   nextBoxHopList.assign(hops, hops + sections[WalkMapSection::HOPS].count);
+
+   portals.resize((size_t)n * n);
+   for (U32 i=0; i<portals.size(); i++)
+   {
+      const WalkMapPortal& baked = bakedPortals[i];
+      Portal& portal = portals[i];
+      portal.midOnSrc = Point2I(baked.midOnSrc[0], baked.midOnSrc[1]);
+      portal.overlapA = Point2I(baked.overlapA[0], baked.overlapA[1]);
+      portal.overlapB = Point2I(baked.overlapB[0], baked.overlapB[1]);
+      portal.hasSegment = baked.hasSegment != 0;
+      portal.valid = baked.valid != 0;
+   }
+
+   boxBounds.resize(n);
+   for (U32 i=0; i<n; i++)
+   {
+      boxBounds[i] = RectI(bakedBounds[i*4], bakedBounds[i*4+1], bakedBounds[i*4+2], bakedBounds[i*4+3]);
+   }
+
+   gridOrigin = Point2I(header->gridOriginX, header->gridOriginY);
+   gridWidth = header->gridWidth;
+   gridHeight = header->gridHeight;
+   gridCellStart.assign(cells, cells + sections[WalkMapSection::GRID_CELLS].count);
+   gridBoxes.assign(cellBoxes, cellBoxes + sections[WalkMapSection::GRID_BOXES].count);
+
+   adjacencyStart.assign(adjStart, adjStart + n + 1);
+   adjacency.assign(adj, adj + sections[WalkMapSection::ADJACENCY].count);
+
+   defaultScaleTable.assign(defaultScales, defaultScales + scaleTableSize);
+   for (U32 i=0; i<NumScaleSlots; i++)
+   {
+      slotScaleTables[i].assign(slotScales + (i * scaleTableSize), slotScales + ((i+1) * scaleTableSize));
+   }
+
+   boxScales.resize(n);
+   for (U32 i=0; i<n; i++)
+   {
+      boxScales[i].scale = bakedBoxScales[i].scale;
+      boxScales[i].slot = (S8)bakedBoxScales[i].slot;
+   }
+
+   // Sanity check the index tables against the box count so a bad file
+   // can't send lookups out of range
+   const bool gridOk = gridWidth >= 0 && gridHeight >= 0 &&
+                       gridCellStart.size() == (size_t)gridWidth * gridHeight + 1 &&
+                       StartsValid(gridCellStart, gridBoxes.size());
+   const bool adjOk = StartsValid(adjacencyStart, adjacency.size());
+   bool idsOk = true;
+   for (U16 id : gridBoxes) idsOk = idsOk && id < n;
+   for (U16 id : adjacency) idsOk = idsOk && id < n;
+   for (U8 hop : nextBoxHopList) idsOk = idsOk && (hop < n || hop == 255);
+   for (U32 i=0; i<n; i++) idsOk = idsOk && bakedBoxScales[i].slot >= -1 && bakedBoxScales[i].slot < (S32)NumScaleSlots;
+   for (const Box& box : boxes) idsOk = idsOk && (box.numPoints == 0 || box.startPoint + box.numPoints <= numPoints);
+
+   if (!gridOk || !adjOk || !idsOk)
+   {
+      Con::errorf("Walk map %s is malformed", path);
+      reset();
+      return false;
+   }
+
+   return true;
+}
+
+
+// Bakes a box file. Rooms load the baked file in place of the box file if
+// it was built from a box file with the same contents.
+ConsoleFunctionValue(compileWalkMap, 2, 3, "(boxFile, [outFile])")
+{
+   const char* boxFile = vmPtr->valueAsString(argv[1]);
+   std::string outFile = argc > 2 ? vmPtr->valueAsString(argv[2]) : BoxInfo::getBakedPath(boxFile);
+
+   MappedFile source;
+   if (!source.open(boxFile))
+   {
+      Con::errorf("compileWalkMap: couldn't open %s", boxFile);
+      return KorkApi::ConsoleValue::makeUnsigned(0);
+   }
+
+   BoxInfo info;
+   const U64 sourceHash = BoxInfo::hashSource(source.getData(), source.getSize());
+   MemStream boxStream(source.getSize(), (void*)source.getData(), true, false);
+   info.read(boxStream);
+   if (info.boxes.empty())
+   {
+      Con::errorf("compileWalkMap: %s is not a valid box file", boxFile);
+      return KorkApi::ConsoleValue::makeUnsigned(0);
+   }
+
+   if (!info.writeBaked(outFile.c_str(), sourceHash))
+   {
+      return KorkApi::ConsoleValue::makeUnsigned(0);
+   }
+
+   Con::printf("compileWalkMap: wrote %s (%u boxes)", outFile.c_str(), (U32)info.boxes.size());
+   return KorkApi::ConsoleValue::makeUnsigned(1);
+}
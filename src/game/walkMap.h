@@ -0,0 +1,111 @@
+#pragma once
+
+//-----------------------------------------------------------------------------
+// Copyright (c) 2026 James S Urquhart
+// See AUTHORS file and git repository for contributor information.
+//
+// SPDX-License-Identifier: MIT
+//-----------------------------------------------------------------------------
+//
+
+
+// Read-only view of a whole file. Uses mmap where available, otherwise the
+// file is read into memory.
+class MappedFile
+{
+public:
+   MappedFile();
+   ~MappedFile();
+
+   bool open(const char* path);
+   void close();
+
+   inline const U8* getData() const { return mData; }
+   inline U32 getSize() const { return mSize; }
+
+private:
+   const U8* mData;
+   U32 mSize;
+   bool mMapped;
+   std::vector<U8> mBuffer;
+};
+
+// Baked walk data, written by compileWalkMap from a room's .box file. Every
+// table BoxInfo builds after loading is stored in its in-memory layout so
+// loading is a straight copy. Layout:
+//
+//    WalkMapHeader
+//    WalkMapSection[NumSections]
+//    section data, each aligned to 8 bytes
+//
+// Data is native endian; the magic won't match on a machine with the other
+// byte order.
+struct WalkMapHeader
+{
+   enum
+   {
+      FileMagic = 0x4D57514F, // OQWM
+      FileVersion = 2
+   };
+
+   U32 magic;
+   U32 version;
+   U64 sourceHash;   // FNV-1a of the .box file this was built from
+   U32 numSections;
+   S32 gridOriginX;
+   S32 gridOriginY;
+   S32 gridWidth;
+   S32 gridHeight;
+   U32 pad;
+};
+
+struct WalkMapSection
+{
+   enum Type
+   {
+      BOXES,
+      NAMES,
+      POINTS,
+      SCALE_BANDS,
+      HOPS,
+      PORTALS,
+      BOX_BOUNDS,
+      GRID_CELLS,
+      GRID_BOXES,
+      ADJACENCY_START,
+      ADJACENCY,
+      DEFAULT_SCALE,
+      SLOT_SCALE,
+      BOX_SCALES,
+      NumSections
+   };
+
+   U32 offset; // from the start of the file
+   U32 count;  // elements, not bytes
+};
+
+struct WalkMapBox
+{
+   U32 nameOffset; // into NAMES, NUL terminated
+   U16 startPoint;
+   U16 numPoints;
+   U16 scale;
+   U8 mask;
+   U8 flags;
+};
+
+struct WalkMapPortal
+{
+   S32 midOnSrc[2];
+   S32 overlapA[2];
+   S32 overlapB[2];
+   U8 hasSegment;
+   U8 valid;
+   U8 pad[2];
+};
+
+struct WalkMapBoxScale
+{
+   F32 scale;
+   S32 slot;
+};